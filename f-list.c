@@ -152,13 +152,30 @@ const gchar *flist_typing_state_string(PurpleTypingState state) {
     default: return "clear";
     }
 }
+/* Nearly every name is plain ASCII, so we fold those in place and only */
+/* fall back to Unicode case folding when we run into a non-ASCII byte. */
+/* The hash is the same g_str_hash() of the lowercase name as before. */
 guint flist_str_hash(const char *nick) {
-    char *lc = g_utf8_strdown(nick, -1);
-    guint bucket = g_str_hash(lc);
-    g_free(lc);
+    const guchar *cur;
+    guint32 bucket = 5381;
+    for(cur = (const guchar *) nick; *cur; cur++) {
+        if(*cur >= 0x80) {
+            char *lc = g_utf8_strdown(nick, -1);
+            bucket = g_str_hash(lc);
+            g_free(lc);
+            return bucket;
+        }
+        bucket = (bucket << 5) + bucket + (guint32) g_ascii_tolower(*cur);
+    }
     return bucket;
 }
 gboolean flist_str_equal(const char *nick1, const char *nick2) {
+    const guchar *cur1 = (const guchar *) nick1, *cur2 = (const guchar *) nick2;
+    for(;; cur1++, cur2++) {
+        if(*cur1 >= 0x80 || *cur2 >= 0x80) break;
+        if(g_ascii_tolower(*cur1) != g_ascii_tolower(*cur2)) return FALSE;
+        if(!*cur1) return TRUE;
+    }
     return (purple_utf8_strcasecmp(nick1, nick2) == 0);
 }
 gint flist_strcmp(const char *nick1, const char *nick2) {
@@ -186,36 +203,6 @@ void flist_g_list_free_full(GList *to_free, GDestroyNotify f) {
     }
     g_list_free(to_free);
 }
-gint flist_pointer_cmp(gconstpointer a, gconstpointer b) {
-    if(a > b) return 1;
-    if(b > a) return -1;
-    return 0;
-}
-/** Runs in O(n log n) (if g_slist_sort is reasonable) */
-GSList *flist_g_slist_intersect_and_free(GSList *list1, GSList *list2) {
-    GSList *ret = NULL;
-    GSList *cur1, *cur2;
-    list1 = g_slist_sort(list1, (GCompareFunc) flist_pointer_cmp);
-    list2 = g_slist_sort(list2, (GCompareFunc) flist_pointer_cmp);
-    cur1 = list1;
-    cur2 = list2;
-    while(cur1 && cur2) {
-        if(cur1->data == cur2->data) { /* we have a match! */
-            ret = g_slist_prepend(ret, cur1->data);
-            cur1 = g_slist_next(cur1);
-            cur2 = g_slist_next(cur2);
-        } else {
-            if(cur1->data > cur2->data) {
-                cur2 = g_slist_next(cur2);
-            } else {
-                cur1 = g_slist_next(cur1);
-            }
-        }
-    }
-    g_slist_free(list1);
-    g_slist_free(list2);
-    return ret;
-}
 
 const char *flist_normalize(const PurpleAccount *account, const char *str) {
     return purple_normalize_nocase(account, str);
@@ -271,30 +258,31 @@ static void flist_set_channel_bool_blist(FListAccount *fla, const gchar *channel
     purple_blist_node_set_int(&(chat->node), key, value ? 1 : -1);
 }
 
+/* The settings live in the buddy list, but joined channels keep a copy, */
+/* which the setters below write through to. This keeps the buddy list out */
+/* of the path of every channel message. */
 gboolean flist_get_channel_show_chat(FListAccount *fla, const gchar *channel) {
-    gint ret = flist_get_channel_bool_blist(fla, channel, CONVO_SHOW_CHAT);
-    switch(ret) {
-        case -1: return FALSE;
-        case 1: return TRUE;
-    }
-    return TRUE;
+    FListChannel *fchannel = flist_channel_find(fla, channel);
+    if(fchannel) return fchannel->show_chat;
+    return flist_get_channel_bool_blist(fla, channel, CONVO_SHOW_CHAT) != -1;
 }
 
 gboolean flist_get_channel_show_ads(FListAccount *fla, const gchar *channel) {
-    gint ret = flist_get_channel_bool_blist(fla, channel, CONVO_SHOW_ADS);
-    switch(ret) {
-        case -1: return FALSE;
-        case 1: return TRUE;
-    }
-    return TRUE;
+    FListChannel *fchannel = flist_channel_find(fla, channel);
+    if(fchannel) return fchannel->show_ads;
+    return flist_get_channel_bool_blist(fla, channel, CONVO_SHOW_ADS) != -1;
 }
 
 void flist_set_channel_show_chat(FListAccount *fla, const gchar *channel, gboolean setting) {
+    FListChannel *fchannel = flist_channel_find(fla, channel);
     flist_set_channel_bool_blist(fla, channel, CONVO_SHOW_CHAT, setting);
+    if(fchannel) fchannel->show_chat = setting;
 }
 
 void flist_set_channel_show_ads(FListAccount *fla, const gchar *channel, gboolean setting) {
+    FListChannel *fchannel = flist_channel_find(fla, channel);
     flist_set_channel_bool_blist(fla, channel, CONVO_SHOW_ADS, setting);
+    if(fchannel) fchannel->show_ads = setting;
 }
 
 void flist_channel_show_message(FListAccount *fla, const gchar *channel) {
@@ -351,7 +339,7 @@ static GList *flist_actions(PurplePlugin *plugin, gpointer context) {
     list = g_list_append(list, act);
 
     if(fla && fla->proper_character) {
-        if(fla->global_ops && g_hash_table_lookup(fla->global_ops, fla->proper_character)) {
+        if(fla->global_ops && g_hash_table_lookup(fla->global_ops, GUINT_TO_POINTER(flist_name_id(fla->names, fla->proper_character)))) {
             list = g_list_append(list, NULL); /* this adds a divider */
             
             act = purple_plugin_action_new(_("Broadcast"), flist_broadcast_action);
@@ -424,6 +412,7 @@ void flist_close(PurpleConnection *pc) {
 
     if(fla->connection_status == FLIST_CONNECT) purple_proxy_connect_cancel((void*) pc);
     if(fla->input_handle > 0) purple_input_remove(fla->input_handle);
+    if(fla->output_handle > 0) purple_input_remove(fla->output_handle);
     if(fla->fd > 0) close(fla->fd);
     if(fla->url_request) purple_util_fetch_url_cancel(fla->url_request);
     
@@ -436,15 +425,21 @@ void flist_close(PurpleConnection *pc) {
     if(fla->ticket_timer) purple_timeout_remove(fla->ticket_timer);
     
     if(fla->fls_cookie) g_free(fla->fls_cookie);
-    g_free(fla->rx_buf);
+    flist_rx_buffer_free(fla->rx_buf);
+    flist_tx_queue_free(fla->tx_queue);
+    if(fla->websocket) flist_websocket_free(fla->websocket);
+    g_object_unref(fla->json_parser);
+    flist_arena_free(fla->frame_arena);
+    if(fla->capture) fclose(fla->capture);
 
     if(fla->ping_timeout_handle) purple_timeout_remove(fla->ping_timeout_handle);
     
-    g_hash_table_destroy(fla->all_characters);
     if(fla->global_ops) g_hash_table_destroy(fla->global_ops);
+    if(fla->unknown_codes) g_hash_table_destroy(fla->unknown_codes);
 
     /* login options */
     if(fla->server_address) g_free(fla->server_address);
+    if(fla->ticket_url) g_free(fla->ticket_url);
 
     if(fla->input_request) purple_request_close_with_handle((void*) pc);
     
@@ -453,17 +448,13 @@ void flist_close(PurpleConnection *pc) {
     flist_global_kinks_unload(pc);
     flist_profile_unload(pc);
     flist_channel_subsystem_unload(fla);
+    flist_characters_unload(fla);
     
     g_free(fla);
 
     pc->proto_data = NULL;
 }
 
-static void flist_character_free(FListCharacter *character) {
-    if(character->name) g_free(character->name);
-    if(character->status_message) g_free(character->status_message);
-    g_free(character);
-}
 void flist_login(PurpleAccount *pa) {
     PurpleConnection *pc = purple_account_get_connection(pa);
     FListAccount *fla;
@@ -473,9 +464,12 @@ void flist_login(PurpleAccount *pa) {
     fla->pa = pa;
     fla->pc = pc;
 
-    fla->all_characters = g_hash_table_new_full((GHashFunc)flist_str_hash, (GEqualFunc)flist_str_equal, g_free, (GDestroyNotify)flist_character_free);
+    flist_characters_load(fla);
 
-    fla->rx_buf = g_malloc0(256); fla->rx_len = 0;
+    fla->rx_buf = flist_rx_buffer_new();
+    fla->tx_queue = flist_tx_queue_new();
+    fla->json_parser = json_parser_new();
+    fla->frame_arena = flist_arena_new();
     pc->proto_data = fla;
 
     ac_split = g_strsplit(purple_account_get_username(pa), ":", 2);
@@ -492,7 +486,12 @@ void flist_login(PurpleAccount *pa) {
     /* login options */
     fla->server_address = g_strdup(purple_account_get_string(pa, "server_address", "chat.f-list.net"));
     fla->server_port = purple_account_get_int(pa, "server_port", FLIST_PORT);
+    fla->ticket_url = g_strdup(purple_account_get_string(pa, "ticket_url", FLIST_TICKET_URL));
     fla->use_websocket_handshake = purple_account_get_bool(pa, "use_websocket_handshake", FALSE);
+    fla->use_rfc6455 = purple_account_get_bool(pa, "use_rfc6455", FALSE);
+    fla->websocket_compression = purple_account_get_bool(pa, "websocket_compression", TRUE);
+    fla->recv_budget = (gsize) MAX(purple_account_get_int(pa, "recv_budget", FLIST_RECV_BUDGET), 1) * 1024;
+    flist_capture_open(fla, purple_account_get_string(pa, "capture_file", ""));
 
     fla->sync_bookmarks = purple_account_get_bool(pa, "sync_bookmarks", FALSE);
     fla->sync_friends = purple_account_get_bool(pa, "sync_friends", TRUE);
@@ -661,10 +660,25 @@ static void plugin_init(PurplePlugin *plugin) {
 
     option = purple_account_option_int_new("Server Port", "server_port", FLIST_PORT);
     prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
+
+    option = purple_account_option_string_new("Ticket URL", "ticket_url", FLIST_TICKET_URL);
+    prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
     
     option = purple_account_option_bool_new("Use WebSocket Handshake", "use_websocket_handshake", FALSE);
     prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
 
+    option = purple_account_option_bool_new("Use RFC 6455 WebSocket", "use_rfc6455", FALSE);
+    prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
+
+    option = purple_account_option_bool_new("Compress WebSocket Traffic", "websocket_compression", TRUE);
+    prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
+
+    option = purple_account_option_int_new("Receive Budget (KiB per event)", "recv_budget", FLIST_RECV_BUDGET);
+    prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
+
+    option = purple_account_option_string_new("Capture Received Data To", "capture_file", "");
+    prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
+
     option = purple_account_option_bool_new("Download Friends List", "sync_friends", TRUE);
     prpl_info.protocol_options = g_list_append(prpl_info.protocol_options, option);
 
@@ -761,7 +775,6 @@ static void plugin_init(PurplePlugin *plugin) {
 
     flist_callback_init();
     flist_init_commands();
-    flist_bbcode_init();
     flist_pidgin_init();
     flist_web_requests_init();
     flist_ticket_init();
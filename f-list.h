@@ -41,6 +41,8 @@
 #    include <dlfcn.h>
 #    include <netinet/in.h>
 #    include <sys/socket.h>
+#    include <sys/resource.h>
+#    include <sys/uio.h>
 #endif
 
 //json-glib sources
@@ -71,6 +73,14 @@ typedef struct FListKinks_ FListKinks;
 typedef struct FListProfiles_ FListProfiles;
 typedef struct FListWebRequestData_ FListWebRequestData;
 typedef struct FListFriends_ FListFriends;
+typedef struct FListRxBuffer_ FListRxBuffer;
+typedef struct FListTxQueue_ FListTxQueue;
+typedef struct FListArena_ FListArena;
+typedef struct FListBitset_ FListBitset;
+typedef struct FListWebSocket_ FListWebSocket;
+typedef struct FListNames_ FListNames;
+typedef struct FListCharacterPool_ FListCharacterPool;
+typedef struct FListStatusMessage_ FListStatusMessage;
 
 //gboolean flist_account_is_operator(PurpleConnection *pc, const gchar *name);
 //void flist_account_set_operator(PurpleConnection *pc, const gchar *name, gboolean operator);
@@ -161,6 +171,7 @@ enum FListStatus_ {
     FLIST_STATUS_OFFLINE,
     FLIST_STATUS_UNKNOWN /* if we don't recognize the status string */
 };
+#define FLIST_STATUS_COUNT (FLIST_STATUS_UNKNOWN + 1)
 
 enum FListGender_ { /* flags make for quick comparisons */
     FLIST_GENDER_NONE = 0x1,
@@ -173,6 +184,7 @@ enum FListGender_ { /* flags make for quick comparisons */
     FLIST_GENDER_CUNTBOY = 0x80,
     FLIST_GENDER_UNKNOWN = 0x100
 };
+#define FLIST_GENDER_COUNT 9
 
 enum FListChannelMode_ {
     CHANNEL_MODE_BOTH = 0,
@@ -229,7 +241,6 @@ const gchar *flist_typing_state_string(PurpleTypingState state);
 void flist_g_list_free(GList *to_free);
 void flist_g_list_free_full(GList *to_free, GDestroyNotify f);
 void flist_g_slist_free_full(GSList *to_free, GDestroyNotify f);
-GSList *flist_g_slist_intersect_and_free(GSList *list1, GSList *list2);
 
 guint flist_str_hash(const char *);
 gboolean flist_str_equal(const char *, const char *);
@@ -256,10 +267,12 @@ void flist_set_channel_show_chat(FListAccount *, const gchar *, gboolean);
 void flist_channel_show_message(FListAccount *, const gchar *);
 
 struct FListCharacter_ {
-    gchar* name;
+    const gchar *name; /* owned by FListAccount.names */
+    guint id;
     FListGender gender;
     FListStatus status;
-    gchar* status_message; /* this is stored html-escaped */
+    FListStatusMessage *status_message; /* shared, see flist_character_set_status_message() */
+    GSList *channels; /* the joined channels (FListChannel) we know they are in */
 };
 
 struct FListRoomlistChannel_ {
@@ -273,10 +286,17 @@ struct FListAccount_ {
     PurpleAccount *pa;
     PurpleConnection *pc;
     
-    GHashTable *global_ops; //hash table of global operators
+    FListNames *names; //every character name seen on this connection
+    FListCharacterPool *character_pool; //where the records in all_characters come from
+    GHashTable *global_ops; //set of global operator IDs
     GHashTable *all_characters; //hash table of FListCharacter, all that are online
+    GHashTable *status_messages; //FListStatusMessage by text
+    FListBitset *online_set; //IDs of the characters in all_characters
+    FListBitset *status_sets[FLIST_STATUS_COUNT]; //the same IDs, split by status
+    FListBitset *gender_sets[FLIST_GENDER_COUNT]; //and by gender, one set per flag
 
     gint characters_remaining;
+    gboolean bulk_loading; //we're receiving the LIS snapshot and hold off on buddy updates
     gboolean online; //whether or not we've set pidgin to say we're online
     guint32 character_count; //total number of characters online, should be count(all_characters)
     gchar *username;
@@ -292,10 +312,14 @@ struct FListAccount_ {
     guint ticket_timer;
     FListWebRequestData *ticket_request;
         
-    gchar *rx_buf;
-    gsize rx_len;
+    FListRxBuffer *rx_buf;
+    FListTxQueue *tx_queue;
+    FListWebSocket *websocket; /* only with the RFC 6455 transport */
+    JsonParser *json_parser; /* reused for every frame */
+    FListArena *frame_arena; /* reset after every frame */
     int fd;
     int input_handle;
+    int output_handle;
     
     PurpleRoomlist *roomlist;
     gboolean input_request;
@@ -312,8 +336,28 @@ struct FListAccount_ {
 
     /* connection options */
     gchar *server_address;
+    gchar *ticket_url;
     gint server_port;
     gboolean use_websocket_handshake; /* enable to use handshake instead of WSH */
+    gboolean use_rfc6455; /* use standard WebSocket framing instead of either */
+    gboolean websocket_compression;
+    gsize recv_budget; /* how many bytes we read from the socket before yielding to the UI */
+    FILE *capture; /* everything we receive is recorded here, when set */
+
+    /* connection statistics */
+    guint64 stat_wakeups;
+    guint64 stat_bytes_in;
+    guint64 stat_frames_in;
+    guint64 stat_process_usec; /* time spent handling received frames */
+    guint stat_last_frames; /* frames handled by the most recent input event */
+    guint stat_max_frames;
+    guint64 stat_writes;
+    guint64 stat_bytes_out;
+    guint64 stat_frames_out;
+    guint stat_max_queue_depth;
+    guint64 stat_fast_hits; /* frames handled without a JsonParser */
+    guint64 stat_fast_misses; /* frames that had to fall back to one */
+    GHashTable *unknown_codes; /* how often we got each command we don't handle */
 
     /* filter subsystem */
     gchar *filter_channel;
@@ -337,6 +381,10 @@ struct FListAccount_ {
 
 //f-list sources
 #include "f-list_http.h"
+#include "f-list_buffer.h"
+#include "f-list_bitset.h"
+#include "f-list_characters.h"
+#include "f-list_websocket.h"
 #include "f-list_callbacks.h"
 #include "f-list_commands.h"
 #include "f-list_autobuddy.h"
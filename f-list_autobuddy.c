@@ -20,43 +20,82 @@
  */
 #include "f-list_autobuddy.h"
 
+static void flist_filter_add_buddy_to_group(FListAccount *fla, const gchar *name, PurpleGroup *filter_group) {
+    PurpleBuddy *b = purple_find_buddy(fla->pa, name);
+    if(!b) { /* we're adding a new buddy */
+        b = purple_buddy_new(fla->pa, name, NULL);
+        purple_blist_add_buddy(b, NULL, filter_group, NULL);
+        purple_account_add_buddy(fla->pa, b);
+    } /* do nothing if this is already a buddy */
+}
+
+static void flist_find_buddies_in_node(PurpleAccount *pa, PurpleBlistNode *n, GSList **current) {
+    while(n) {
+        if(PURPLE_BLIST_NODE_IS_BUDDY(n) && PURPLE_BUDDY(n)->account == pa) {
+            *current = g_slist_prepend(*current, n);
+        }
+        if(n->child) flist_find_buddies_in_node(pa, n->child, current);
+        n = n->next;
+    }
+}
+
+/* We only look at what is in the search group, and decide what stays with */
+/* a hash set of the new results, so this is linear in both. */
 void flist_apply_filter(FListAccount *fla, GSList *candidates) {
-    PurpleGroup *filter_group = NULL;
-    GSList *buddies, *cur;
-    GSList *removed = NULL;
+    PurpleGroup *filter_group = flist_get_filter_group(fla);
+    GHashTable *wanted = g_hash_table_new((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal);
+    GSList *buddies = NULL, *cur;
+    GList *added = NULL;
+    guint added_count = 0, removed_count = 0, kept_count = 0;
 
-    filter_group = flist_get_filter_group(fla);
-    
-    buddies = purple_find_buddies(fla->pa, NULL);
-    cur = buddies;
-    while(cur) {
-        PurpleBuddy *b = cur->data; cur = g_slist_next(cur);
-        const gchar *name = purple_buddy_get_name(b);
-        if(purple_buddy_get_group(b) == filter_group) {
-            if(!g_slist_find_custom(candidates, name, (GCompareFunc) flist_strcmp)) { //TODO: this is extremely inefficient, fix it!
-                removed = g_slist_prepend(removed, b);
-            }
+    for(cur = candidates; cur; cur = g_slist_next(cur)) {
+        g_hash_table_replace(wanted, cur->data, NULL);
+    }
+
+    flist_find_buddies_in_node(fla->pa, PURPLE_BLIST_NODE(filter_group)->child, &buddies);
+    for(cur = buddies; cur; cur = g_slist_next(cur)) {
+        PurpleBuddy *b = cur->data;
+        if(g_hash_table_lookup_extended(wanted, purple_buddy_get_name(b), NULL, NULL)) {
+            kept_count++;
+        } else {
+            purple_blist_remove_buddy(b);
+            removed_count++;
         }
     }
     g_slist_free(buddies);
 
-    cur = removed;
-    while(cur) {
-        PurpleBuddy *b = cur->data; cur = g_slist_next(cur);
-        purple_blist_remove_buddy(b);
+    /* the new buddies go to the account in one batch */
+    for(cur = candidates; cur; cur = g_slist_next(cur)) {
+        const gchar *name = cur->data;
+        if(!purple_find_buddy(fla->pa, name)) { /* leave existing buddies where they are */
+            PurpleBuddy *b = purple_buddy_new(fla->pa, name, NULL);
+            purple_blist_add_buddy(b, NULL, filter_group, NULL);
+            added = g_list_prepend(added, b);
+            added_count++;
+        }
+    }
+    if(added) {
+        purple_account_add_buddies(fla->pa, added);
+        g_list_free(added);
     }
-    g_slist_free(removed);
+    g_hash_table_destroy(wanted);
 
-    cur = candidates;
-    while(cur) {
-        const gchar *name = cur->data; cur = g_slist_next(cur);
-        purple_debug_info("flist", "adding %s\n", name);
-        PurpleBuddy *b = purple_find_buddy(fla->pa, name);
-        if(!b) { /* we're adding a new buddy */
-            b = purple_buddy_new(fla->pa, name, NULL);
-            purple_blist_add_buddy(b, NULL, filter_group, NULL);
-            purple_account_add_buddy(fla->pa, b);
-        } /* do nothing if this is already a buddy */
+    purple_debug_info(FLIST_DEBUG, "Applied search results: %u added, %u removed, %u kept.\n",
+        added_count, removed_count, kept_count);
+}
+
+void flist_filter_add_buddy(FListAccount *fla, const gchar *name) {
+    purple_debug_info("flist", "adding %s\n", name);
+    flist_filter_add_buddy_to_group(fla, name, flist_get_filter_group(fla));
+}
+
+void flist_filter_remove_buddy(FListAccount *fla, const gchar *name) {
+    PurpleBuddy *b = purple_find_buddy(fla->pa, name);
+    
+    /* only search results are removed, never friends or bookmarks */
+    if(b && purple_buddy_get_group(b) == flist_get_filter_group(fla)) {
+        purple_debug_info("flist", "removing %s\n", name);
+        purple_blist_remove_buddy(b);
     }
 }
 
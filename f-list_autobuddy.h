@@ -26,4 +26,8 @@
 void flist_apply_filter(FListAccount *, GSList *characters);
 void flist_clear_filter(FListAccount *);
 
+/* single changes to the search group, for live searches */
+void flist_filter_add_buddy(FListAccount *, const gchar *name);
+void flist_filter_remove_buddy(FListAccount *, const gchar *name);
+
 #endif
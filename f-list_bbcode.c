@@ -20,12 +20,15 @@
  */
 #include "f-list_bbcode.h"
 
-typedef struct ParserVars_ {
-    FListAccount *fla;
-    PurpleConversation *convo;
-} ParserVars;
+/* The parser writes straight into one output buffer. An open tag is */
+/* written out raw, as it would stay if it was never closed; when it is */
+/* closed, the raw tag is replaced with the HTML in front of its (already */
+/* converted) contents, and the closing HTML is appended. */
+
+typedef struct BBCodeParser_ BBCodeParser;
+typedef struct BBCodeOpen_ BBCodeOpen;
 
-typedef gchar *(*tag_format)(ParserVars *vars, const gchar *ts, const gchar *inner);
+typedef void (*tag_format)(BBCodeParser *parser, BBCodeOpen *open);
 typedef struct BBCodeTag_ {
     const gchar *tag; /* the tag */
     gboolean nesting; /* whether or not other tags are allowed to nest inside this one*/
@@ -33,134 +36,209 @@ typedef struct BBCodeTag_ {
     tag_format format; /* this is how we format the string */
 } BBCodeTag;
 
-gchar *flist_escape_attribute(const gchar *to_escape) {
-    GString *ret = g_string_new(NULL);
-    const gchar *current, *next;
-    current = to_escape;
-    while((next = strchr(current, '\"'))) {
+struct BBCodeParser_ {
+    FListAccount *fla;
+    PurpleConversation *convo;
+    GString *out;
+    GString *scratch; /* for building longer opening HTML, made when needed */
+};
+
+struct BBCodeOpen_ {
+    BBCodeTag *tag;
+    gsize start; /* where the raw tag is in the output */
+    gsize raw_tag_len;
+    const gchar *argument; /* points into the input, not terminated */
+    gsize argument_len;
+};
+
+/* the stack lives on the C stack unless tags nest deeper than this */
+#define BBCODE_STACK_SIZE 16
+
+static void bbcode_append_attribute(GString *ret, const gchar *to_escape, gsize len) {
+    const gchar *current = to_escape, *end = to_escape + len, *next;
+    while((next = memchr(current, '\"', (gsize) (end - current)))) {
         g_string_append_len(ret, current, (gsize) (next - current));
         g_string_append(ret, "\"");
         current = next + 1;
     }
-    g_string_append(ret, current);
-    return g_string_free(ret, FALSE);
+    g_string_append_len(ret, current, (gsize) (end - current));
+}
+
+static GString *bbcode_scratch(BBCodeParser *parser) {
+    if(!parser->scratch) parser->scratch = g_string_new(NULL);
+    g_string_truncate(parser->scratch, 0);
+    return parser->scratch;
+}
+
+static const gchar *bbcode_inner(BBCodeParser *parser, BBCodeOpen *open, gsize *len) {
+    gsize start = open->start + open->raw_tag_len;
+    *len = parser->out->len - start;
+    return parser->out->str + start;
+}
+
+/* replaces the raw tag with the given text, moving the contents once */
+static void bbcode_replace_raw_tag(BBCodeParser *parser, BBCodeOpen *open, const gchar *with, gsize with_len) {
+    GString *out = parser->out;
+    gsize inner_start = open->start + open->raw_tag_len;
+    gsize inner_len = out->len - inner_start;
+
+    if(with_len > open->raw_tag_len) {
+        g_string_set_size(out, out->len + (with_len - open->raw_tag_len));
+    }
+    memmove(out->str + open->start + with_len, out->str + inner_start, inner_len);
+    memcpy(out->str + open->start, with, with_len);
+    g_string_truncate(out, open->start + with_len + inner_len);
+}
+
+static void bbcode_wrap(BBCodeParser *parser, BBCodeOpen *open, const gchar *before, const gchar *after) {
+    bbcode_replace_raw_tag(parser, open, before, strlen(before));
+    g_string_append(parser->out, after);
 }
 
 //TODO: replace all of these with CSS
-static gchar *format_bold(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    return g_strdup_printf("<b>%s</b>", inner);
+static void format_bold(BBCodeParser *parser, BBCodeOpen *open) {
+    bbcode_wrap(parser, open, "<b>", "</b>");
 }
-static gchar *format_italic(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    return g_strdup_printf("<i>%s</i>", inner);
+static void format_italic(BBCodeParser *parser, BBCodeOpen *open) {
+    bbcode_wrap(parser, open, "<i>", "</i>");
 }
-static gchar *format_strike(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    return g_strdup_printf("<s>%s</s>", inner);
+static void format_strike(BBCodeParser *parser, BBCodeOpen *open) {
+    bbcode_wrap(parser, open, "<s>", "</s>");
 }
-static gchar *format_underline(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    return g_strdup_printf("<u>%s</u>", inner);
+static void format_underline(BBCodeParser *parser, BBCodeOpen *open) {
+    bbcode_wrap(parser, open, "<u>", "</u>");
 }
-static gchar *format_url(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    gchar *escaped, *ret;
-    if(strlen(ts) > 0) {
-        escaped = flist_escape_attribute(ts);
+static void format_url(BBCodeParser *parser, BBCodeOpen *open) {
+    GString *before = bbcode_scratch(parser);
+    g_string_append(before, "<a href=\"");
+    if(open->argument_len > 0) {
+        bbcode_append_attribute(before, open->argument, open->argument_len);
     } else {
-        escaped = flist_escape_attribute(inner);
+        gsize inner_len;
+        const gchar *inner = bbcode_inner(parser, open, &inner_len);
+        bbcode_append_attribute(before, inner, inner_len);
     }
-    ret = g_strdup_printf("<a href=\"%s\">%s</a>", escaped, inner);
-    g_free(escaped);
-    return ret;
+    g_string_append(before, "\">");
+    bbcode_replace_raw_tag(parser, open, before->str, before->len);
+    g_string_append(parser->out, "</a>");
 }
-static gchar *format_color(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    if(strlen(ts) > 0) {
-        gchar *escaped, *ret;
-        escaped = flist_escape_attribute(ts);
-        ret = g_strdup_printf("<font color=\"%s\">%s</font>", escaped, inner);
-        g_free(escaped);
-        return ret;
+static void format_color(BBCodeParser *parser, BBCodeOpen *open) {
+    if(open->argument_len > 0) {
+        GString *before = bbcode_scratch(parser);
+        g_string_append(before, "<font color=\"");
+        bbcode_append_attribute(before, open->argument, open->argument_len);
+        g_string_append(before, "\">");
+        bbcode_replace_raw_tag(parser, open, before->str, before->len);
+        g_string_append(parser->out, "</font>");
+        return;
     }
-    return g_strdup(inner);
+    bbcode_replace_raw_tag(parser, open, "", 0);
 }
-static gchar *format_user(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    const gchar *url_pattern = "<a href=\"http://www.f-list.net/c/%s\">%s</a>";
-    gchar *lower = g_utf8_strdown(inner, -1);
-    gchar *ret = g_strdup_printf(url_pattern, purple_url_encode(lower), inner);
+static void format_user(BBCodeParser *parser, BBCodeOpen *open) {
+    GString *before = bbcode_scratch(parser);
+    gsize inner_len;
+    const gchar *inner = bbcode_inner(parser, open, &inner_len);
+    gchar *lower = g_utf8_strdown(inner, (gssize) inner_len);
+    g_string_append(before, "<a href=\"http://www.f-list.net/c/");
+    g_string_append(before, purple_url_encode(lower));
+    g_string_append(before, "\">");
+    bbcode_replace_raw_tag(parser, open, before->str, before->len);
+    g_string_append(parser->out, "</a>");
     g_free(lower);
-    return ret;
 }
-static gchar *format_icon(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    gchar *lower = g_utf8_strdown(inner, -1);
-    gchar *ret;
-    if(vars->fla && vars->convo) {
-        gchar *smiley = g_strdup_printf("[icon]%s[/icon]", purple_url_encode(lower));
-        ret = g_strdup_printf("%s<a href=\"http://www.f-list.net/c/%s\">(%s)</a>", smiley, purple_url_encode(lower), inner);
-        flist_fetch_emoticon(vars->fla, smiley, lower, vars->convo);
+static void format_icon(BBCodeParser *parser, BBCodeOpen *open) {
+    GString *before = bbcode_scratch(parser);
+    gsize inner_len;
+    const gchar *inner = bbcode_inner(parser, open, &inner_len);
+    gchar *lower = g_utf8_strdown(inner, (gssize) inner_len);
+    gchar *encoded = g_strdup(purple_url_encode(lower));
+    if(parser->fla && parser->convo) {
+        gchar *smiley = g_strdup_printf("[icon]%s[/icon]", encoded);
+        g_string_append(before, smiley);
+        g_string_append_printf(before, "<a href=\"http://www.f-list.net/c/%s\">(", encoded);
+        bbcode_replace_raw_tag(parser, open, before->str, before->len);
+        g_string_append(parser->out, ")</a>");
+        flist_fetch_emoticon(parser->fla, smiley, lower, parser->convo);
         g_free(smiley);
     } else {
-        ret = g_strdup_printf("<a href=\"http://www.f-list.net/c/%s\">%s</a>", purple_url_encode(lower), inner);
+        g_string_append_printf(before, "<a href=\"http://www.f-list.net/c/%s\">", encoded);
+        bbcode_replace_raw_tag(parser, open, before->str, before->len);
+        g_string_append(parser->out, "</a>");
     }
+    g_free(encoded);
     g_free(lower);
-    return ret;
 }
 
-static gchar *format_channel_real(ParserVars *vars, const gchar *name, const gchar *title) {
-    PurpleAccount *pa;
-    gchar *unescaped, *ret;
-    GString *gs;
-    if(!vars->fla) return g_strdup(name);
+/* the link text is the contents of the tag, unless a title is given */
+static void format_channel_real(BBCodeParser *parser, BBCodeOpen *open, const gchar *title, gsize title_len) {
+    GString *before;
+    gchar *name, *unescaped;
+    gsize inner_len;
+    const gchar *inner;
+
+    if(!parser->fla) {
+        bbcode_replace_raw_tag(parser, open, "", 0);
+        return;
+    }
+    inner = bbcode_inner(parser, open, &inner_len);
+    name = g_strndup(inner, inner_len);
     unescaped = purple_unescape_html(name);
 
-    gs = g_string_new(NULL);
-    pa = vars->fla->pa;
-    g_string_append(gs, "<a href=\"flistc://");
-    g_string_append(gs, purple_url_encode(flist_serialize_account(pa)));
-    g_string_append_c(gs, '/');
-    g_string_append(gs, purple_url_encode(unescaped));
-    g_string_append(gs, "\">(Channel) ");
-    g_string_append(gs, title);
-    g_string_append(gs, "</a>");
-    ret = g_string_free(gs, FALSE);
+    before = bbcode_scratch(parser);
+    g_string_append(before, "<a href=\"flistc://");
+    g_string_append(before, purple_url_encode(flist_serialize_account(parser->fla->pa)));
+    g_string_append_c(before, '/');
+    g_string_append(before, purple_url_encode(unescaped));
+    g_string_append(before, "\">(Channel) ");
+    if(title) {
+        g_string_truncate(parser->out, open->start);
+        g_string_append_len(parser->out, before->str, before->len);
+        g_string_append_len(parser->out, title, title_len);
+    } else {
+        bbcode_replace_raw_tag(parser, open, before->str, before->len);
+    }
+    g_string_append(parser->out, "</a>");
 
     g_free(unescaped);
-    return ret;
+    g_free(name);
 }
-static gchar *format_channel(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    return format_channel_real(vars, inner, inner);
+static void format_channel(BBCodeParser *parser, BBCodeOpen *open) {
+    format_channel_real(parser, open, NULL, 0);
 }
-static gchar *format_session(ParserVars *vars, const gchar *ts, const gchar *inner) {
-    return format_channel_real(vars, inner, ts ? ts : inner);
+static void format_session(BBCodeParser *parser, BBCodeOpen *open) {
+    format_channel_real(parser, open, open->argument, open->argument_len);
 }
 
-static GHashTable *tag_table;
-
-BBCodeTag tag_bold = { "b", TRUE, FALSE, format_bold };
-BBCodeTag tag_italic = { "i", TRUE, FALSE, format_italic };
-BBCodeTag tag_underline = { "u", TRUE, FALSE, format_underline };
-BBCodeTag tag_strike = { "s", TRUE, FALSE, format_strike };
-BBCodeTag tag_url = { "url", FALSE, TRUE, format_url };
-BBCodeTag tag_color = { "color", TRUE, TRUE, format_color };
-BBCodeTag tag_user = { "user", FALSE, FALSE, format_user };
-BBCodeTag tag_icon = { "icon", FALSE, FALSE, format_icon };
-BBCodeTag tag_channel = { "channel", FALSE, FALSE, format_channel };
-BBCodeTag tag_session = { "session", FALSE, FALSE, format_session };
-
-typedef struct BBCodeStack_ BBCodeStack;
-struct BBCodeStack_ {
-    BBCodeStack *next;
-    BBCodeTag *tag;
-    gchar *tag_argument;
-    GString *ret;
-    /* the raw tag */
-    const gchar *raw_tag;
-    gsize raw_tag_len;
+static BBCodeTag tag_bold = { "b", TRUE, FALSE, format_bold };
+static BBCodeTag tag_italic = { "i", TRUE, FALSE, format_italic };
+static BBCodeTag tag_underline = { "u", TRUE, FALSE, format_underline };
+static BBCodeTag tag_strike = { "s", TRUE, FALSE, format_strike };
+static BBCodeTag tag_url = { "url", FALSE, TRUE, format_url };
+static BBCodeTag tag_color = { "color", TRUE, TRUE, format_color };
+static BBCodeTag tag_user = { "user", FALSE, FALSE, format_user };
+static BBCodeTag tag_icon = { "icon", FALSE, FALSE, format_icon };
+static BBCodeTag tag_channel = { "channel", FALSE, FALSE, format_channel };
+static BBCodeTag tag_session = { "session", FALSE, FALSE, format_session };
+
+static BBCodeTag *tags[] = {
+    &tag_bold, &tag_italic, &tag_underline, &tag_strike, &tag_url,
+    &tag_color, &tag_user, &tag_icon, &tag_channel, &tag_session, NULL
 };
 
+/* there are few enough tags that comparing them all beats hashing a copy */
+static BBCodeTag *bbcode_find_tag(const gchar *name, gsize len) {
+    BBCodeTag **tag;
+    for(tag = tags; *tag; tag++) {
+        if(!strncmp((*tag)->tag, name, len) && (*tag)->tag[len] == '\0') return *tag;
+    }
+    return NULL;
+}
+
 static gboolean bbcode_parse_tag(const gchar *raw_tag, gsize raw_tag_len,
-        BBCodeTag *current_tag, BBCodeTag **ret_tag,
-        gchar **ret_tag_argument, gboolean *ret_close_tag) {
+        BBCodeTag *current_tag, BBCodeOpen *ret_open, gboolean *ret_close_tag) {
     BBCodeTag *bbtag;
     const gchar *start = raw_tag + 1, *end = raw_tag + raw_tag_len - 1;
-    const gchar *split = g_strstr_len(raw_tag, raw_tag_len, "=");
-    gchar *tag, *arg;
+    const gchar *split = memchr(raw_tag, '=', raw_tag_len);
     gboolean close_tag;
 
     if(raw_tag[1] == '/') {
@@ -171,97 +249,87 @@ static gboolean bbcode_parse_tag(const gchar *raw_tag, gsize raw_tag_len,
     }
 
     if(split) {
-        tag = g_strndup(start, (gsize) (split - start));
-        arg = g_strndup(split + 1, (gsize) (end - (split + 1)));
+        bbtag = bbcode_find_tag(start, (gsize) (split - start));
+        ret_open->argument = split + 1;
+        ret_open->argument_len = (gsize) (end - (split + 1));
     } else {
-        tag = g_strndup(start, (gsize) (end - start));
-        arg = g_strdup("");
+        bbtag = bbcode_find_tag(start, (gsize) (end - start));
+        ret_open->argument = end;
+        ret_open->argument_len = 0;
     }
 
-    bbtag = g_hash_table_lookup(tag_table, tag);
-    g_free(tag);
     if(bbtag) {
         if(close_tag && bbtag == current_tag) { /* we're closing a tag ... */
             *ret_close_tag = TRUE;
-            g_free(arg);
             return TRUE;
         }
         if(!close_tag && (!current_tag || current_tag->nesting)) { /* we're opening a tag ... */
-            *ret_tag = bbtag;
-            *ret_tag_argument = arg;
+            ret_open->tag = bbtag;
             *ret_close_tag = FALSE;
             return TRUE;
         }
     }
-    
-    g_free(arg);
     return FALSE;
 }
 
 gchar *flist_bbcode_to_html_real(FListAccount *fla, PurpleConversation *convo, const gchar *bbcode, gboolean strip) {
-    ParserVars vars = {fla, convo};
-    BBCodeStack stack_base = {NULL, NULL, NULL, NULL, NULL, 0};
-    BBCodeStack *stack = &stack_base, *stack_tmp;
+    BBCodeParser parser = {fla, convo, NULL, NULL};
+    BBCodeOpen stack_base[BBCODE_STACK_SIZE];
+    BBCodeOpen *stack = stack_base, open_tag;
+    guint depth = 0, stack_size = BBCODE_STACK_SIZE;
     const gchar *current, *open, *close;
-    const gchar *raw_tag; gsize raw_tag_len;
-    BBCodeTag *tag;
-    gchar *tag_argument;
+    gsize len = strlen(bbcode);
     gboolean close_tag;
 
-    stack->ret = g_string_new(NULL);
+    /* most of the output is the input, and the HTML is not much longer */
+    parser.out = g_string_sized_new(len + len / 4 + 64);
 
     current = bbcode;
     while(TRUE) {
         open = strchr(current, '['); if(!open) break;
         close = strchr(open, ']'); if(!close) break;
         close += 1; /* add in the ']' */
-        raw_tag = open;
-        raw_tag_len = close - open;
 
         /* append the raw text before the tag */
-        g_string_append_len(stack->ret, current, (gsize) (open - current));
+        g_string_append_len(parser.out, current, (gsize) (open - current));
         current = close;
-        
-        if(bbcode_parse_tag(raw_tag, raw_tag_len, stack->tag, &tag, &tag_argument, &close_tag)) {
+
+        if(bbcode_parse_tag(open, (gsize) (close - open), depth ? stack[depth - 1].tag : NULL, &open_tag, &close_tag)) {
             if(!close_tag) { /* we have a new tag! push it onto the stack */
-                stack_tmp = g_new(BBCodeStack, 1);
-                stack_tmp->next = stack;
-                stack = stack_tmp;
-                stack->raw_tag = raw_tag;
-                stack->raw_tag_len = raw_tag_len;
-                stack->tag = tag;
-                stack->tag_argument = tag_argument;
-                stack->ret = g_string_new(NULL);
+                if(depth == stack_size) {
+                    stack_size *= 2;
+                    if(stack == stack_base) {
+                        stack = g_new(BBCodeOpen, stack_size);
+                        memcpy(stack, stack_base, sizeof(stack_base));
+                    } else {
+                        stack = g_renew(BBCodeOpen, stack, stack_size);
+                    }
+                }
+                open_tag.start = parser.out->len;
+                open_tag.raw_tag_len = (gsize) (close - open);
+                stack[depth++] = open_tag;
+                /* this is what stays if the tag is never closed */
+                g_string_append_len(parser.out, open, (gsize) (close - open));
             } else { /* we are closing a tag! pop it off of the stack */
-                gchar *inner = g_string_free(stack->ret, FALSE);
-                gchar *final = !strip ? stack->tag->format(&vars, stack->tag_argument, inner) : g_strdup(inner);
-                stack_tmp = stack;
-                stack = stack->next;
-                g_string_append(stack->ret, final);
-                g_free(stack_tmp->tag_argument);
-                g_free(stack_tmp);
-                g_free(inner);
-                g_free(final);
+                BBCodeOpen *top = &stack[--depth];
+                if(!strip) {
+                    top->tag->format(&parser, top);
+                } else {
+                    bbcode_replace_raw_tag(&parser, top, "", 0);
+                }
             }
         } else { /* this tag is not valid in this context! ignore it */
-            g_string_append_len(stack->ret, raw_tag, (gsize) (raw_tag_len));
+            g_string_append_len(parser.out, open, (gsize) (close - open));
         }
     }
 
-    while(stack->next) {
-        gchar *final = g_string_free(stack->ret, FALSE);
-        stack_tmp = stack;
-        stack = stack->next;
-        g_string_append_len(stack->ret, stack_tmp->raw_tag, stack_tmp->raw_tag_len); /* append the unclosed tag as raw text */
-        g_string_append(stack->ret, final); /* append the parsed interior of the unclosed tag */
-        g_free(stack_tmp->tag_argument);
-        g_free(stack_tmp);
-        g_free(final);
-    }
+    /* unclosed tags are already in the output as raw text */
+    if(stack != stack_base) g_free(stack);
+    if(parser.scratch) g_string_free(parser.scratch, TRUE);
 
     /* append everything past the close of the last tag */
-    g_string_append(stack->ret, current);
-    return g_string_free(stack->ret, FALSE);
+    g_string_append(parser.out, current);
+    return g_string_free(parser.out, FALSE);
 }
 
 gchar *flist_bbcode_to_html(FListAccount *fla, PurpleConversation *convo, const gchar *bbcode) {
@@ -287,17 +355,3 @@ gchar *flist_strip_crlf(const gchar *to_strip) {
     
     return g_string_free(ret, FALSE);
 }
-
-void flist_bbcode_init() {
-    tag_table = g_hash_table_new(g_str_hash, g_str_equal);
-    g_hash_table_insert(tag_table, "b", &tag_bold);
-    g_hash_table_insert(tag_table, "i", &tag_italic);
-    g_hash_table_insert(tag_table, "u", &tag_underline);
-    g_hash_table_insert(tag_table, "s", &tag_strike);
-    g_hash_table_insert(tag_table, "url", &tag_url);
-    g_hash_table_insert(tag_table, "color", &tag_color);
-    g_hash_table_insert(tag_table, "user", &tag_user);
-    g_hash_table_insert(tag_table, "icon", &tag_icon);
-    g_hash_table_insert(tag_table, "channel", &tag_channel);
-    g_hash_table_insert(tag_table, "session", &tag_session);
-}
@@ -26,7 +26,6 @@
 gchar *flist_bbcode_to_html(FListAccount *, PurpleConversation *, const gchar *);
 gchar *flist_bbcode_strip(const gchar *);
 gchar *flist_strip_crlf(const gchar *);
-void flist_bbcode_init();
 
 #endif	/* F_LIST_BBCODE_H */
 
@@ -0,0 +1,136 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "f-list_bitset.h"
+
+#define FLIST_BITSET_WORD_BITS 64
+#define FLIST_BITSET_MIN_WORDS 64
+
+struct FListBitset_ {
+    guint64 *words;
+    gsize len; /* words allocated; everything past them is zero */
+};
+
+#if defined(__GNUC__)
+#define flist_popcount64(w) ((guint) __builtin_popcountll(w))
+#define flist_ctz64(w) ((guint) __builtin_ctzll(w))
+#else
+static inline guint flist_popcount64(guint64 w) {
+    w = w - ((w >> 1) & G_GUINT64_CONSTANT(0x5555555555555555));
+    w = (w & G_GUINT64_CONSTANT(0x3333333333333333)) + ((w >> 2) & G_GUINT64_CONSTANT(0x3333333333333333));
+    w = (w + (w >> 4)) & G_GUINT64_CONSTANT(0x0F0F0F0F0F0F0F0F);
+    return (guint) ((w * G_GUINT64_CONSTANT(0x0101010101010101)) >> 56);
+}
+static inline guint flist_ctz64(guint64 w) {
+    return flist_popcount64((w & -w) - 1);
+}
+#endif
+
+FListBitset *flist_bitset_new() {
+    return g_new0(FListBitset, 1);
+}
+
+void flist_bitset_free(FListBitset *set) {
+    g_free(set->words);
+    g_free(set);
+}
+
+static void flist_bitset_grow(FListBitset *set, gsize len) {
+    gsize new_len = set->len ? set->len : FLIST_BITSET_MIN_WORDS;
+
+    if(len <= set->len) return;
+    while(new_len < len) new_len *= 2;
+    set->words = g_renew(guint64, set->words, new_len);
+    memset(set->words + set->len, 0, (new_len - set->len) * sizeof(guint64));
+    set->len = new_len;
+}
+
+void flist_bitset_add(FListBitset *set, guint bit) {
+    gsize word = bit / FLIST_BITSET_WORD_BITS;
+    flist_bitset_grow(set, word + 1);
+    set->words[word] |= G_GUINT64_CONSTANT(1) << (bit % FLIST_BITSET_WORD_BITS);
+}
+
+void flist_bitset_remove(FListBitset *set, guint bit) {
+    gsize word = bit / FLIST_BITSET_WORD_BITS;
+    if(word >= set->len) return;
+    set->words[word] &= ~(G_GUINT64_CONSTANT(1) << (bit % FLIST_BITSET_WORD_BITS));
+}
+
+gboolean flist_bitset_contains(FListBitset *set, guint bit) {
+    gsize word = bit / FLIST_BITSET_WORD_BITS;
+    if(word >= set->len) return FALSE;
+    return (set->words[word] >> (bit % FLIST_BITSET_WORD_BITS)) & 1;
+}
+
+void flist_bitset_clear(FListBitset *set) {
+    if(set->len) memset(set->words, 0, set->len * sizeof(guint64));
+}
+
+void flist_bitset_copy(FListBitset *dest, FListBitset *src) {
+    flist_bitset_grow(dest, src->len);
+    if(src->len) memcpy(dest->words, src->words, src->len * sizeof(guint64));
+    if(dest->len > src->len) memset(dest->words + src->len, 0, (dest->len - src->len) * sizeof(guint64));
+}
+
+/* The kernels below are plain loops over whole words, which the compiler */
+/* can vectorize; none of them allocate unless dest has to grow. */
+void flist_bitset_union(FListBitset *dest, FListBitset *src) {
+    guint64 *d, *s;
+    gsize i;
+
+    flist_bitset_grow(dest, src->len);
+    d = dest->words; s = src->words;
+    for(i = 0; i < src->len; i++) d[i] |= s[i];
+}
+
+void flist_bitset_intersect(FListBitset *dest, FListBitset *src) {
+    guint64 *d = dest->words, *s = src->words;
+    gsize len = MIN(dest->len, src->len), i;
+
+    for(i = 0; i < len; i++) d[i] &= s[i];
+    if(dest->len > len) memset(d + len, 0, (dest->len - len) * sizeof(guint64));
+}
+
+guint flist_bitset_count(FListBitset *set) {
+    guint count = 0;
+    gsize i;
+
+    for(i = 0; i < set->len; i++) count += flist_popcount64(set->words[i]);
+    return count;
+}
+
+gboolean flist_bitset_next(FListBitset *set, guint *bit) {
+    gsize word = *bit / FLIST_BITSET_WORD_BITS;
+    guint64 w;
+
+    if(word >= set->len) return FALSE;
+    w = set->words[word] & (~G_GUINT64_CONSTANT(0) << (*bit % FLIST_BITSET_WORD_BITS));
+    while(!w) {
+        if(++word >= set->len) return FALSE;
+        w = set->words[word];
+    }
+    *bit = (guint) (word * FLIST_BITSET_WORD_BITS + flist_ctz64(w));
+    return TRUE;
+}
+
+gsize flist_bitset_bytes(FListBitset *set) {
+    return set->len * sizeof(guint64);
+}
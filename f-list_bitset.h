@@ -0,0 +1,46 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLIST_BITSET_H
+#define	FLIST_BITSET_H
+
+#include "f-list.h"
+
+/* A set of small integers (character IDs), one bit each. It grows as */
+/* needed; bits that were never set read as zero. */
+FListBitset *flist_bitset_new();
+void flist_bitset_free(FListBitset *);
+
+void flist_bitset_add(FListBitset *, guint bit);
+void flist_bitset_remove(FListBitset *, guint bit);
+gboolean flist_bitset_contains(FListBitset *, guint bit);
+void flist_bitset_clear(FListBitset *);
+
+/* these replace the first set with the result */
+void flist_bitset_copy(FListBitset *dest, FListBitset *src);
+void flist_bitset_union(FListBitset *dest, FListBitset *src);
+void flist_bitset_intersect(FListBitset *dest, FListBitset *src);
+
+guint flist_bitset_count(FListBitset *);
+/* finds the first member that is at least *bit; returns FALSE if there is none */
+gboolean flist_bitset_next(FListBitset *, guint *bit);
+gsize flist_bitset_bytes(FListBitset *);
+
+#endif	/* FLIST_BITSET_H */
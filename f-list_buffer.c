@@ -0,0 +1,382 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "f-list_buffer.h"
+
+/* Received data is kept in a chain of fixed-size chunks. Bytes are written */
+/* once and never moved while they are unread; a chunk is recycled as soon */
+/* as everything in it has been consumed. */
+#define FLIST_RX_CHUNK_SIZE 16384
+/* don't recv() into the end of a chunk with less room than this */
+#define FLIST_RX_CHUNK_MIN_FREE 1024
+
+typedef struct FListRxChunk_ FListRxChunk;
+
+struct FListRxChunk_ {
+    FListRxChunk *next;
+    gsize start; /* the first unread byte */
+    gsize end; /* one past the last received byte */
+    gchar data[FLIST_RX_CHUNK_SIZE];
+};
+
+/* blocks for the per-frame scratch arena */
+#define FLIST_ARENA_BLOCK_SIZE 4096
+
+typedef struct FListTxFrame_ FListTxFrame;
+typedef struct FListArenaBlock_ FListArenaBlock;
+
+struct FListTxFrame_ {
+    GString *data;
+    gsize offset; /* the first unsent byte */
+};
+
+struct FListTxQueue_ {
+    GQueue *frames;
+    gsize len; /* the number of unsent bytes */
+};
+
+struct FListArenaBlock_ {
+    FListArenaBlock *next;
+    gsize size;
+    gsize used;
+    gchar data[];
+};
+
+struct FListArena_ {
+    FListArenaBlock *blocks; /* the block we're allocating from comes first */
+    guint64 allocs; /* allocations handed out */
+    guint64 block_allocs; /* allocations we had to make from the heap */
+};
+
+struct FListRxBuffer_ {
+    FListRxChunk *head;
+    FListRxChunk *tail;
+    FListRxChunk *spare; /* kept around so that we don't allocate in the steady state */
+    gsize len; /* the number of unread bytes */
+    gsize scanned; /* how many unread bytes are known not to hold scan_char */
+    gchar scan_char;
+    GString *scratch; /* holds a frame that spans more than one chunk */
+};
+
+static FListRxChunk *flist_rx_chunk_new(FListRxBuffer *rxb) {
+    FListRxChunk *chunk = rxb->spare;
+
+    if(chunk) {
+        rxb->spare = NULL;
+    } else {
+        chunk = g_new(FListRxChunk, 1);
+    }
+    chunk->next = NULL;
+    chunk->start = 0;
+    chunk->end = 0;
+    return chunk;
+}
+
+static void flist_rx_chunk_release(FListRxBuffer *rxb, FListRxChunk *chunk) {
+    if(!rxb->spare) {
+        rxb->spare = chunk;
+    } else {
+        g_free(chunk);
+    }
+}
+
+FListRxBuffer *flist_rx_buffer_new() {
+    FListRxBuffer *rxb = g_new0(FListRxBuffer, 1);
+    rxb->head = rxb->tail = flist_rx_chunk_new(rxb);
+    rxb->scratch = g_string_new(NULL);
+    return rxb;
+}
+
+void flist_rx_buffer_free(FListRxBuffer *rxb) {
+    FListRxChunk *chunk = rxb->head;
+
+    while(chunk) {
+        FListRxChunk *next = chunk->next;
+        g_free(chunk);
+        chunk = next;
+    }
+    if(rxb->spare) g_free(rxb->spare);
+    g_string_free(rxb->scratch, TRUE);
+    g_free(rxb);
+}
+
+gchar *flist_rx_buffer_reserve(FListRxBuffer *rxb, gsize *available) {
+    FListRxChunk *tail = rxb->tail;
+
+    if(FLIST_RX_CHUNK_SIZE - tail->end < FLIST_RX_CHUNK_MIN_FREE) {
+        tail->next = flist_rx_chunk_new(rxb);
+        rxb->tail = tail = tail->next;
+    }
+    *available = FLIST_RX_CHUNK_SIZE - tail->end;
+    return tail->data + tail->end;
+}
+
+void flist_rx_buffer_commit(FListRxBuffer *rxb, gsize len) {
+    rxb->tail->end += len;
+    rxb->len += len;
+}
+
+gsize flist_rx_buffer_length(FListRxBuffer *rxb) {
+    return rxb->len;
+}
+
+/* We remember how far we got, so a frame that arrives over many reads is */
+/* only scanned once. memchr() is vectorized by the C library already. */
+gboolean flist_rx_buffer_find(FListRxBuffer *rxb, gchar c, gsize *offset) {
+    FListRxChunk *chunk;
+    gsize base = 0;
+
+    if(c != rxb->scan_char) {
+        rxb->scan_char = c;
+        rxb->scanned = 0;
+    }
+
+    for(chunk = rxb->head; chunk; chunk = chunk->next) {
+        gsize chunk_len = chunk->end - chunk->start;
+        gsize skip;
+        const gchar *found;
+        if(base + chunk_len <= rxb->scanned) { /* we've been through this one */
+            base += chunk_len;
+            continue;
+        }
+        skip = rxb->scanned > base ? rxb->scanned - base : 0;
+        found = memchr(chunk->data + chunk->start + skip, c, chunk_len - skip);
+        if(found) {
+            *offset = base + (gsize) (found - (chunk->data + chunk->start));
+            rxb->scanned = *offset;
+            return TRUE;
+        }
+        base += chunk_len;
+    }
+    rxb->scanned = base;
+    return FALSE;
+}
+
+const gchar *flist_rx_buffer_peek(FListRxBuffer *rxb, gsize len) {
+    FListRxChunk *chunk = rxb->head;
+
+    g_return_val_if_fail(len <= rxb->len, NULL);
+
+    if(chunk->end - chunk->start >= len) { /* this is the usual case */
+        return chunk->data + chunk->start;
+    }
+
+    /* the data spans several chunks, so we have to copy it together once */
+    g_string_truncate(rxb->scratch, 0);
+    while(len > 0) {
+        gsize n = MIN(len, chunk->end - chunk->start);
+        g_string_append_len(rxb->scratch, chunk->data + chunk->start, n);
+        len -= n;
+        chunk = chunk->next;
+    }
+    return rxb->scratch->str;
+}
+
+void flist_rx_buffer_consume(FListRxBuffer *rxb, gsize len) {
+    g_return_if_fail(len <= rxb->len);
+
+    rxb->len -= len;
+    rxb->scanned = rxb->scanned > len ? rxb->scanned - len : 0;
+    while(len > 0) {
+        FListRxChunk *chunk = rxb->head;
+        gsize n = MIN(len, chunk->end - chunk->start);
+        chunk->start += n;
+        len -= n;
+        if(chunk->start == chunk->end) {
+            if(chunk == rxb->tail) { /* nothing is left unread, so start over */
+                chunk->start = 0;
+                chunk->end = 0;
+            } else {
+                rxb->head = chunk->next;
+                flist_rx_chunk_release(rxb, chunk);
+            }
+        }
+    }
+}
+
+FListTxQueue *flist_tx_queue_new() {
+    FListTxQueue *txq = g_new0(FListTxQueue, 1);
+    txq->frames = g_queue_new();
+    return txq;
+}
+
+static void flist_tx_frame_free(FListTxFrame *frame) {
+    g_string_free(frame->data, TRUE);
+    g_free(frame);
+}
+
+void flist_tx_queue_free(FListTxQueue *txq) {
+    FListTxFrame *frame;
+
+    while((frame = g_queue_pop_head(txq->frames))) {
+        flist_tx_frame_free(frame);
+    }
+    g_queue_free(txq->frames);
+    g_free(txq);
+}
+
+void flist_tx_queue_push(FListTxQueue *txq, GString *data, gsize offset) {
+    FListTxFrame *frame = g_new(FListTxFrame, 1);
+    frame->data = data;
+    frame->offset = offset;
+    g_queue_push_tail(txq->frames, frame);
+    txq->len += data->len - offset;
+}
+
+guint flist_tx_queue_depth(FListTxQueue *txq) {
+    return g_queue_get_length(txq->frames);
+}
+
+gsize flist_tx_queue_length(FListTxQueue *txq) {
+    return txq->len;
+}
+
+#ifndef _WIN32
+int flist_tx_queue_get_iov(FListTxQueue *txq, struct iovec *iov, int max) {
+    GList *cur;
+    int count = 0;
+
+    for(cur = txq->frames->head; cur && count < max; cur = cur->next) {
+        FListTxFrame *frame = cur->data;
+        iov[count].iov_base = frame->data->str + frame->offset;
+        iov[count].iov_len = frame->data->len - frame->offset;
+        count++;
+    }
+    return count;
+}
+#endif
+
+const gchar *flist_tx_queue_peek(FListTxQueue *txq, gsize *len) {
+    FListTxFrame *frame = g_queue_peek_head(txq->frames);
+
+    if(!frame) {
+        *len = 0;
+        return NULL;
+    }
+    *len = frame->data->len - frame->offset;
+    return frame->data->str + frame->offset;
+}
+
+void flist_tx_queue_advance(FListTxQueue *txq, gsize len) {
+    g_return_if_fail(len <= txq->len);
+
+    txq->len -= len;
+    while(len > 0) {
+        FListTxFrame *frame = g_queue_peek_head(txq->frames);
+        gsize n = MIN(len, frame->data->len - frame->offset);
+        frame->offset += n;
+        len -= n;
+        if(frame->offset == frame->data->len) {
+            g_queue_pop_head(txq->frames);
+            flist_tx_frame_free(frame);
+        }
+    }
+}
+
+static FListArenaBlock *flist_arena_block_new(FListArena *arena, gsize size) {
+    FListArenaBlock *block = g_malloc(sizeof(FListArenaBlock) + size);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    arena->block_allocs++;
+    return block;
+}
+
+FListArena *flist_arena_new() {
+    FListArena *arena = g_new0(FListArena, 1);
+    arena->blocks = flist_arena_block_new(arena, FLIST_ARENA_BLOCK_SIZE);
+    return arena;
+}
+
+void flist_arena_free(FListArena *arena) {
+    FListArenaBlock *block = arena->blocks;
+
+    while(block) {
+        FListArenaBlock *next = block->next;
+        g_free(block);
+        block = next;
+    }
+    g_free(arena);
+}
+
+/* If we overflowed the first block, we replace all of them with one block */
+/* that is big enough, so the next frame of that size fits without a malloc. */
+void flist_arena_reset(FListArena *arena) {
+    FListArenaBlock *block = arena->blocks;
+    gsize total = 0;
+
+    if(!block->next) {
+        block->used = 0;
+        return;
+    }
+    while(block) {
+        FListArenaBlock *next = block->next;
+        total += block->size;
+        g_free(block);
+        block = next;
+    }
+    arena->blocks = flist_arena_block_new(arena, total);
+}
+
+gpointer flist_arena_alloc(FListArena *arena, gsize size) {
+    FListArenaBlock *block = arena->blocks;
+    gpointer ret;
+
+    size = (size + 7) & ~((gsize) 7);
+    if(block->size - block->used < size) {
+        block = flist_arena_block_new(arena, MAX(size, FLIST_ARENA_BLOCK_SIZE));
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    ret = block->data + block->used;
+    block->used += size;
+    arena->allocs++;
+    return ret;
+}
+
+gchar *flist_arena_strndup(FListArena *arena, const gchar *str, gsize len) {
+    gchar *ret = flist_arena_alloc(arena, len + 1);
+    memcpy(ret, str, len);
+    ret[len] = '\0';
+    return ret;
+}
+
+gchar *flist_arena_printf(FListArena *arena, const gchar *format, ...) {
+    va_list args, args_copy;
+    gchar *ret;
+    int len;
+
+    va_start(args, format);
+    va_copy(args_copy, args);
+    len = vsnprintf(NULL, 0, format, args_copy);
+    va_end(args_copy);
+    ret = flist_arena_alloc(arena, (gsize) MAX(len, 0) + 1);
+    vsnprintf(ret, (gsize) MAX(len, 0) + 1, format, args);
+    va_end(args);
+    return ret;
+}
+
+guint64 flist_arena_allocs(FListArena *arena) {
+    return arena->allocs;
+}
+
+guint64 flist_arena_block_allocs(FListArena *arena) {
+    return arena->block_allocs;
+}
@@ -0,0 +1,64 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLIST_BUFFER_H
+#define	FLIST_BUFFER_H
+
+#include "f-list.h"
+
+FListRxBuffer *flist_rx_buffer_new();
+void flist_rx_buffer_free(FListRxBuffer *);
+
+/* returns space to recv() into; call commit with the number of bytes written */
+gchar *flist_rx_buffer_reserve(FListRxBuffer *, gsize *available);
+void flist_rx_buffer_commit(FListRxBuffer *, gsize len);
+
+gsize flist_rx_buffer_length(FListRxBuffer *);
+gboolean flist_rx_buffer_find(FListRxBuffer *, gchar c, gsize *offset);
+/* the returned pointer is valid until the next consume, and is not terminated */
+const gchar *flist_rx_buffer_peek(FListRxBuffer *, gsize len);
+void flist_rx_buffer_consume(FListRxBuffer *, gsize len);
+
+FListTxQueue *flist_tx_queue_new();
+void flist_tx_queue_free(FListTxQueue *);
+
+/* takes ownership of the string; sending starts at offset */
+void flist_tx_queue_push(FListTxQueue *, GString *data, gsize offset);
+guint flist_tx_queue_depth(FListTxQueue *);
+gsize flist_tx_queue_length(FListTxQueue *);
+#ifndef _WIN32
+/* fills in up to max entries, starting with the first unsent byte */
+int flist_tx_queue_get_iov(FListTxQueue *, struct iovec *iov, int max);
+#endif
+const gchar *flist_tx_queue_peek(FListTxQueue *, gsize *len);
+/* drops len bytes that have been written, keeping partially written frames */
+void flist_tx_queue_advance(FListTxQueue *, gsize len);
+
+/* a bump allocator for data that only lives while one frame is handled */
+FListArena *flist_arena_new();
+void flist_arena_free(FListArena *);
+void flist_arena_reset(FListArena *);
+gpointer flist_arena_alloc(FListArena *, gsize size);
+gchar *flist_arena_strndup(FListArena *, const gchar *str, gsize len);
+gchar *flist_arena_printf(FListArena *, const gchar *format, ...) G_GNUC_PRINTF(2, 3);
+guint64 flist_arena_allocs(FListArena *);
+guint64 flist_arena_block_allocs(FListArena *);
+
+#endif	/* FLIST_BUFFER_H */
@@ -20,7 +20,22 @@
  */
 #include "f-list_callbacks.h"
 
-static GHashTable *callbacks = NULL;
+/* Every command code is three uppercase letters, so we can index a table */
+/* with the code directly. Each slot holds a position in callback_entries. */
+#define FLIST_CODE_SPACE (26 * 26 * 26)
+#define FLIST_MAX_CALLBACKS 64
+
+typedef gboolean(*flist_cb_fn)(PurpleConnection *, JsonObject *);
+typedef struct FListFastCallback_ FListFastCallback;
+
+typedef struct FListCallbackEntry_ {
+    flist_cb_fn callback;
+    const FListFastCallback *fast;
+} FListCallbackEntry;
+
+static guint8 callback_index[FLIST_CODE_SPACE]; /* 0 means no callback */
+static FListCallbackEntry callback_entries[FLIST_MAX_CALLBACKS];
+static guint callback_count = 0;
 
 //NOT IMPLEMENTED: AWC // ADMIN ALTERNATE WATCH
 
@@ -31,7 +46,7 @@ static GHashTable *callbacks = NULL;
 #define FLIST_ERROR_PROFILE_FLOOD    7
 
 static GHashTable *flist_global_ops_new() {
-    return g_hash_table_new_full((GHashFunc)flist_str_hash, (GEqualFunc)flist_str_equal, g_free, NULL);
+    return g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 static void flist_purple_find_chats_in_node(PurpleAccount *pa, PurpleBlistNode *n, GSList **current) {
     while(n) {
@@ -108,30 +123,58 @@ static gboolean flist_process_ERR(PurpleConnection *pc, JsonObject *root) {
     //TODO: error messages have context!
 }
 
-static gboolean flist_process_NLN(PurpleConnection *pc, JsonObject *root) {
-    PurpleAccount *pa = purple_connection_get_account(pc);
+/* Buddies are updated in one pass once the LIS snapshot is complete, */
+/* instead of looking each online character up in the buddy list. */
+static void flist_bulk_load_finish(PurpleConnection *pc) {
     FListAccount *fla = pc->proto_data;
-    
-    g_return_val_if_fail(root, TRUE);
+    GSList *buddies, *cur;
+    guint total = 0, updated = 0;
+
+    fla->bulk_loading = FALSE;
+    buddies = purple_find_buddies(fla->pa, NULL);
+    for(cur = buddies; cur; cur = cur->next) {
+        const gchar *name = purple_buddy_get_name(cur->data);
+        total++;
+        if(flist_get_character(fla, name)) {
+            flist_update_friend(pc, name, TRUE, FALSE);
+            updated++;
+        }
+    }
+    g_slist_free(buddies);
+    purple_debug_info(FLIST_DEBUG, "Finished loading %u online characters; %u of %u buddies are online.\n",
+        g_hash_table_size(fla->all_characters), updated, total);
+}
 
-    FListCharacter *character = g_new0(FListCharacter, 1);
-    character->name = g_strdup(json_object_get_string_member(root, "identity"));
-    character->gender = flist_parse_gender(json_object_get_string_member(root, "gender"));
-    character->status = flist_parse_status(json_object_get_string_member(root, "status"));
-    character->status_message = g_strdup("");
+static gboolean flist_handle_NLN(PurpleConnection *pc, const gchar *identity, const gchar *gender, const gchar *status) {
+    FListAccount *fla = pc->proto_data;
+    FListCharacter *character = flist_character_new(fla, identity);
+
+    character->gender = flist_parse_gender(gender);
+    character->status = flist_parse_status(status);
+    flist_character_set_status_message(fla, character, "");
 
-    g_hash_table_replace(fla->all_characters, g_strdup(flist_normalize(pa, character->name)), character);
+    flist_character_add(fla, character);
     fla->character_count += 1;
 
     flist_update_friend(pc, character->name, TRUE, FALSE);
+    flist_filter_character_changed(fla, character);
     
     if(!fla->online && flist_str_equal(fla->proper_character, character->name)) {
+        /* our own NLN comes after the snapshot, even if the count was off */
+        if(fla->bulk_loading) flist_bulk_load_finish(pc);
         flist_got_online(pc);
     }
 
     return TRUE;
 }
 
+static gboolean flist_process_NLN(PurpleConnection *pc, JsonObject *root) {
+    g_return_val_if_fail(root, TRUE);
+
+    return flist_handle_NLN(pc, json_object_get_string_member(root, "identity"),
+        json_object_get_string_member(root, "gender"), json_object_get_string_member(root, "status"));
+}
+
 gint flist_channel_cmp(FListRoomlistChannel *c1, FListRoomlistChannel *c2) {
     return ((gint) c2->users) - ((gint) c1->users);
 }
@@ -211,80 +254,88 @@ static gboolean flist_process_ORS(PurpleConnection *pc, JsonObject *root) {
     return TRUE;
 }
 
-static gboolean flist_process_STA(PurpleConnection *pc, JsonObject *root) {
+static gboolean flist_handle_STA(PurpleConnection *pc, const gchar *name, const gchar *status, const gchar *status_message) {
     FListAccount *fla = pc->proto_data;
     FListCharacter *character;
-    const gchar *name, *status, *status_message;
 
-    g_return_val_if_fail(root, TRUE);
-    name = json_object_get_string_member(root, "character");
-    status = json_object_get_string_member(root, "status");
-    status_message = json_object_get_string_member(root, "statusmsg");
     g_return_val_if_fail(name, TRUE);
 
     character = g_hash_table_lookup(fla->all_characters, name);
     if(character) {
         if(status) {
-            character->status = flist_parse_status(status);
+            flist_character_set_status(fla, character, flist_parse_status(status));
         }
         if(status_message) {
-            character->status_message = g_markup_escape_text(status_message, -1);
+            flist_character_set_status_message(fla, character, status_message);
         }
         flist_update_friend(pc, name, FALSE, FALSE);
+        flist_filter_character_changed(fla, character);
     }
     
     return TRUE;
 }
 
-static gboolean flist_process_FLN(PurpleConnection *pc, JsonObject *root) {
-    FListAccount *fla = pc->proto_data;
-    const gchar *character;
-    
+static gboolean flist_process_STA(PurpleConnection *pc, JsonObject *root) {
     g_return_val_if_fail(root, TRUE);
+
+    return flist_handle_STA(pc, json_object_get_string_member(root, "character"),
+        json_object_get_string_member(root, "status"), json_object_get_string_member(root, "statusmsg"));
+}
+
+static gboolean flist_handle_FLN(PurpleConnection *pc, const gchar *character) {
+    FListAccount *fla = pc->proto_data;
     
-    character = json_object_get_string_member(root, "character");
-    g_hash_table_remove(fla->all_characters, character);
+    flist_filter_character_offline(fla, character);
+    flist_update_user_chats_offline(pc, character); /* this needs their channel list */
+    flist_character_remove(fla, character);
     fla->character_count -= 1;
 
     flist_update_friend(pc, character, FALSE, FALSE);
-    flist_update_user_chats_offline(pc, character);
     
     return TRUE;
 }
 
-static gboolean flist_process_MSG(PurpleConnection *pc, JsonObject *root) {
+static gboolean flist_process_FLN(PurpleConnection *pc, JsonObject *root) {
+    g_return_val_if_fail(root, TRUE);
+    
+    return flist_handle_FLN(pc, json_object_get_string_member(root, "character"));
+}
+
+static gboolean flist_handle_MSG(PurpleConnection *pc, const gchar *channel, const gchar *character, const gchar *message) {
     FListAccount *fla = pc->proto_data;
     PurpleAccount *pa = purple_connection_get_account(pc);
     PurpleConversation *convo;
-    const gchar *character;
-    const gchar *message;
-    const gchar *channel;
+    FListChannel *fchannel;
     gchar *parsed;
-    gboolean show;
-    PurpleMessageFlags flags;
     
-    channel = json_object_get_string_member(root, "channel");
-    character = json_object_get_string_member(root, "character");
-    message = json_object_get_string_member(root, "message");
+    g_return_val_if_fail(channel != NULL && character != NULL && message != NULL, TRUE);
+    
+    /* hidden chat is only counted, so it costs next to nothing */
+    fchannel = flist_channel_find(fla, channel);
+    if(fchannel && !fchannel->show_chat) {
+        fchannel->hidden_messages++;
+        return TRUE;
+    }
     
     convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel, pa);
     if(!convo) {
         purple_debug_error("flist", "Received message for channel %s, but we are not in this channel.\n", channel);
         return TRUE;
     }
-    
-    show = flist_get_channel_show_chat(fla, channel);
-    flags = (show ? PURPLE_MESSAGE_RECV : PURPLE_MESSAGE_INVISIBLE);
+    if(!fchannel && !flist_get_channel_show_chat(fla, channel)) return TRUE;
 
     parsed = flist_bbcode_to_html(fla, convo, message);
     purple_debug_info("flist", "Message: %s\n", parsed);
-    if(show) {
-        serv_got_chat_in(pc, purple_conv_chat_get_id(PURPLE_CONV_CHAT(convo)), character, flags, parsed, time(NULL));
-    }
+    serv_got_chat_in(pc, purple_conv_chat_get_id(PURPLE_CONV_CHAT(convo)), character, PURPLE_MESSAGE_RECV, parsed, time(NULL));
     g_free(parsed);
     return TRUE;
 }
 
+static gboolean flist_process_MSG(PurpleConnection *pc, JsonObject *root) {
+    return flist_handle_MSG(pc, json_object_get_string_member(root, "channel"),
+        json_object_get_string_member(root, "character"), json_object_get_string_member(root, "message"));
+}
+
 //TODO: Record advertisements for later use.
 static gboolean flist_process_LRP(PurpleConnection *pc, JsonObject *root) {
     FListAccount *fla = pc->proto_data;
@@ -293,31 +344,34 @@ static gboolean flist_process_LRP(PurpleConnection *pc, JsonObject *root) {
     const gchar *character;
     const gchar *message;
     const gchar *channel;
+    FListChannel *fchannel;
     gchar *full_message, *parsed;
-    gboolean show;
-    PurpleMessageFlags flags;
     
     channel = json_object_get_string_member(root, "channel");
+    
+    /* hidden ads are only counted, so it costs next to nothing */
+    fchannel = channel ? flist_channel_find(fla, channel) : NULL;
+    if(fchannel && !fchannel->show_ads) {
+        fchannel->hidden_ads++;
+        return TRUE;
+    }
+    
     character = json_object_get_string_member(root, "character");
     message = json_object_get_string_member(root, "message");
+    g_return_val_if_fail(channel != NULL && character != NULL && message != NULL, TRUE);
     
     convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel, pa);
     if(!convo) {
         purple_debug_error("flist", "Received advertisement for channel %s, but we are not in this channel.\n", channel);
         return TRUE;
     }
-    
-    show = flist_get_channel_show_ads(fla, channel);
-    flags = (show ? PURPLE_MESSAGE_RECV : PURPLE_MESSAGE_INVISIBLE);
+    if(!fchannel && !flist_get_channel_show_ads(fla, channel)) return TRUE;
 
-    full_message = g_strdup_printf("[b](Roleplay Ad)[/b] %s", message);
+    full_message = flist_arena_printf(fla->frame_arena, "[b](Roleplay Ad)[/b] %s", message);
     parsed = flist_bbcode_to_html(fla, convo, full_message);
     purple_debug_info("flist", "Advertisement: %s\n", parsed);
-    if(show) {
-        serv_got_chat_in(pc, purple_conv_chat_get_id(PURPLE_CONV_CHAT(convo)), character, flags, parsed, time(NULL));
-    }
+    serv_got_chat_in(pc, purple_conv_chat_get_id(PURPLE_CONV_CHAT(convo)), character, PURPLE_MESSAGE_RECV, parsed, time(NULL));
     g_free(parsed);
-    g_free(full_message);
     return TRUE;
 }
 
@@ -369,9 +423,8 @@ static gboolean flist_process_SYS(PurpleConnection *pc, JsonObject *root) {
         g_free(parsed);
     } else {
         parsed = flist_bbcode_to_html(fla, NULL, message);
-        final = g_strdup_printf("(System) %s", parsed);
+        final = flist_arena_printf(fla->frame_arena, "(System) %s", parsed);
         serv_got_im(pc, GLOBAL_NAME, final, PURPLE_MESSAGE_SYSTEM, time(NULL));
-        g_free(final);
         g_free(parsed);
     }
 
@@ -390,11 +443,15 @@ static gboolean flist_process_CON(PurpleConnection *pc, JsonObject *root) {
         return FALSE;
     }
 
+    if(fla->characters_remaining > 0) {
+        flist_characters_reserve(fla, (guint) fla->characters_remaining);
+        fla->bulk_loading = TRUE;
+    }
+
     return TRUE;
 }
 
 static gboolean flist_process_LIS(PurpleConnection *pc, JsonObject *root) {
-    PurpleAccount *pa = purple_connection_get_account(pc);
     FListAccount *fla = pc->proto_data;
     JsonArray *characters;
     guint32 len;
@@ -407,19 +464,24 @@ static gboolean flist_process_LIS(PurpleConnection *pc, JsonObject *root) {
     
     len = json_array_get_length(characters);
     for(i = 0; i < len; i++) {
-        FListCharacter *character = g_new0(FListCharacter, 1);
+        FListCharacter *character;
         character_array = json_array_get_array_element(characters, i);
         
         g_return_val_if_fail(character_array, TRUE);
         g_return_val_if_fail(json_array_get_length(character_array) == 4, TRUE);
         
-        character->name = g_strdup(json_array_get_string_element(character_array, 0));
+        character = flist_character_new(fla, json_array_get_string_element(character_array, 0));
         character->gender = flist_parse_gender(json_array_get_string_element(character_array, 1));
         character->status = flist_parse_status(json_array_get_string_element(character_array, 2));
-        character->status_message = g_markup_escape_text(json_array_get_string_element(character_array, 3), -1);
+        flist_character_set_status_message(fla, character, json_array_get_string_element(character_array, 3));
         
-        g_hash_table_replace(fla->all_characters, g_strdup(flist_normalize(pa, character->name)), character);
-        flist_update_friend(pc, character->name, TRUE, FALSE);
+        flist_character_add(fla, character);
+        if(!fla->bulk_loading) flist_update_friend(pc, character->name, TRUE, FALSE);
+    }
+    
+    if(fla->bulk_loading) {
+        fla->characters_remaining -= (gint) len;
+        if(fla->characters_remaining <= 0) flist_bulk_load_finish(pc);
     }
     
     return TRUE;
@@ -429,17 +491,15 @@ static gboolean flist_process_AOP(PurpleConnection *pc, JsonObject *root) {
     PurpleAccount *pa = purple_connection_get_account(pc);
     FListAccount *fla = pc->proto_data;
     const gchar *character;
-    gchar *identity;
+    gpointer id;
 
     character = json_object_get_string_member(root, "character");
     g_return_val_if_fail(character, TRUE);
     if(!fla->global_ops) fla->global_ops = flist_global_ops_new();
 
-    identity = g_strdup(character);
-    g_hash_table_replace(fla->global_ops, identity, identity);
-    flist_update_user_chats_rank(pc, identity);
-
-    g_free(identity);
+    id = GUINT_TO_POINTER(flist_name_intern(fla->names, character));
+    g_hash_table_replace(fla->global_ops, id, id);
+    flist_update_user_chats_rank(pc, character);
 
     purple_prpl_got_account_actions(pa);
     return TRUE;
@@ -454,7 +514,7 @@ static gboolean flist_process_DOP(PurpleConnection *pc, JsonObject *root) {
     g_return_val_if_fail(character, TRUE);
     if(!fla->global_ops) fla->global_ops = flist_global_ops_new();
 
-    g_hash_table_remove(fla->global_ops, character);
+    g_hash_table_remove(fla->global_ops, GUINT_TO_POINTER(flist_name_id(fla->names, character)));
     flist_update_user_chats_rank(pc, character);
 
     purple_prpl_got_account_actions(pa);
@@ -477,8 +537,8 @@ static gboolean flist_process_ADL(PurpleConnection *pc, JsonObject *root) {
     fla->global_ops = flist_global_ops_new();
     len = json_array_get_length(ops);
     for(i = 0; i < len; i++) {
-        gchar *identity = g_strdup(json_array_get_string_element(ops, i));
-        g_hash_table_insert(fla->global_ops, identity, identity);
+        gpointer id = GUINT_TO_POINTER(flist_name_intern(fla->names, json_array_get_string_element(ops, i)));
+        g_hash_table_insert(fla->global_ops, id, id);
     }
 
     /* update the status of everyone in the old table */
@@ -500,25 +560,23 @@ static gboolean flist_process_ADL(PurpleConnection *pc, JsonObject *root) {
     return TRUE;
 }
 
-static gboolean flist_process_TPN(PurpleConnection *pc, JsonObject *root) {
-    const gchar *character, *status;
-    
-    character = json_object_get_string_member(root, "character");
-    status = json_object_get_string_member(root, "status");
-    
+static gboolean flist_handle_TPN(PurpleConnection *pc, const gchar *character, const gchar *status) {
     serv_got_typing(pc, character, 0, flist_typing_state(status));
     
     return TRUE;
 }
 
+static gboolean flist_process_TPN(PurpleConnection *pc, JsonObject *root) {
+    return flist_handle_TPN(pc, json_object_get_string_member(root, "character"),
+        json_object_get_string_member(root, "status"));
+}
+
 
 static gboolean flist_process_WSH(PurpleConnection *pc, JsonObject *root) {
     flist_IDN(pc);
     return TRUE;
 }
 
-typedef gboolean(*flist_cb_fn)(PurpleConnection *, JsonObject *);
-
 static gboolean flist_process_IDN(PurpleConnection *pc, JsonObject *root) {
     FListAccount *fla = pc->proto_data;
     const gchar *character;
@@ -561,74 +619,189 @@ static gboolean flist_process_RTB(PurpleConnection *pc, JsonObject *root) {
     return TRUE;
 }
 
+/* Presence and chat traffic is decoded without building a JSON tree. */
+#define FLIST_FAST_MAX_KEYS 3
+
+typedef gboolean(*flist_fast_cb_fn)(PurpleConnection *, const gchar **values);
+
+struct FListFastCallback_ {
+    const gchar *code;
+    const gchar *keys[FLIST_FAST_MAX_KEYS + 1];
+    flist_fast_cb_fn callback;
+};
+
+static gboolean flist_fast_NLN(PurpleConnection *pc, const gchar **values) {
+    return flist_handle_NLN(pc, values[0], values[1], values[2]);
+}
+static gboolean flist_fast_FLN(PurpleConnection *pc, const gchar **values) {
+    return flist_handle_FLN(pc, values[0]);
+}
+static gboolean flist_fast_STA(PurpleConnection *pc, const gchar **values) {
+    return flist_handle_STA(pc, values[0], values[1], values[2]);
+}
+static gboolean flist_fast_TPN(PurpleConnection *pc, const gchar **values) {
+    return flist_handle_TPN(pc, values[0], values[1]);
+}
+static gboolean flist_fast_MSG(PurpleConnection *pc, const gchar **values) {
+    return flist_handle_MSG(pc, values[0], values[1], values[2]);
+}
+
+static const FListFastCallback fast_callbacks[] = {
+    { "NLN", { "identity", "gender", "status", NULL }, flist_fast_NLN },
+    { "FLN", { "character", NULL }, flist_fast_FLN },
+    { "STA", { "character", "status", "statusmsg", NULL }, flist_fast_STA },
+    { "TPN", { "character", "status", NULL }, flist_fast_TPN },
+    { "MSG", { "channel", "character", "message", NULL }, flist_fast_MSG },
+    { NULL }
+};
+
+static gint flist_code_index(const gchar *code) {
+    if(code[0] < 'A' || code[0] > 'Z' || code[1] < 'A' || code[1] > 'Z' || code[2] < 'A' || code[2] > 'Z' || code[3]) {
+        return -1;
+    }
+    return (code[0] - 'A') * 26 * 26 + (code[1] - 'A') * 26 + (code[2] - 'A');
+}
+
+static const FListCallbackEntry *flist_callback_lookup(const gchar *code) {
+    gint index = flist_code_index(code);
+    if(index < 0 || !callback_index[index]) return NULL;
+    return &callback_entries[callback_index[index]];
+}
+
+static void flist_callback_count_unknown(FListAccount *fla, const gchar *code) {
+    guint count;
+
+    if(!fla->unknown_codes) {
+        fla->unknown_codes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(fla->unknown_codes, code));
+    g_hash_table_replace(fla->unknown_codes, g_strdup(code), GUINT_TO_POINTER(count + 1));
+}
+
+gboolean flist_callback_fast(PurpleConnection *pc, const gchar *code, const gchar *data, gsize len) {
+    FListAccount *fla = pc->proto_data;
+    const FListCallbackEntry *entry = flist_callback_lookup(code);
+    const FListFastCallback *fast;
+    const gchar *values[FLIST_FAST_MAX_KEYS];
+    guint n_keys = 0;
+
+    if(!entry || !(fast = entry->fast)) return FALSE;
+
+    while(fast->keys[n_keys]) n_keys++;
+    if(!flist_json_decode_flat(fla->frame_arena, data, len, fast->keys, values, n_keys)) {
+        fla->stat_fast_misses++;
+        return FALSE;
+    }
+    fla->stat_fast_hits++;
+    fast->callback(pc, values);
+    return TRUE;
+}
+
 gboolean flist_callback(PurpleConnection *pc, const gchar *code, JsonObject *root) {
-    flist_cb_fn callback = g_hash_table_lookup(callbacks, code);
-    if(!callback) return TRUE;
-    return callback(pc, root);
+    const FListCallbackEntry *entry = flist_callback_lookup(code);
+    if(!entry) {
+        flist_callback_count_unknown(pc->proto_data, code);
+        return TRUE;
+    }
+    return entry->callback(pc, root);
+}
+
+void flist_callback_stats(FListAccount *fla, GString *str) {
+    GList *codes, *cur;
+
+    if(!fla->unknown_codes || g_hash_table_size(fla->unknown_codes) == 0) {
+        g_string_append(str, "Unhandled commands: none<br>");
+        return;
+    }
+    g_string_append(str, "Unhandled commands:");
+    codes = g_list_sort(g_hash_table_get_keys(fla->unknown_codes), (GCompareFunc) strcmp);
+    for(cur = codes; cur; cur = cur->next) {
+        const gchar *code = cur->data;
+        gchar *escaped = g_markup_escape_text(code, -1); /* these came from the server */
+        g_string_append_printf(str, " %s (%u)", escaped, GPOINTER_TO_UINT(g_hash_table_lookup(fla->unknown_codes, code)));
+        g_free(escaped);
+    }
+    g_string_append(str, "<br>");
+    g_list_free(codes);
 }
+
+static void flist_callback_register(const gchar *code, flist_cb_fn callback) {
+    gint index = flist_code_index(code);
+    const FListFastCallback *fast;
+
+    g_return_if_fail(index >= 0);
+    g_return_if_fail(callback_count + 1 < FLIST_MAX_CALLBACKS);
+
+    callback_count++;
+    callback_entries[callback_count].callback = callback;
+    for(fast = fast_callbacks; fast->code; fast++) {
+        if(!strcmp(fast->code, code)) callback_entries[callback_count].fast = fast;
+    }
+    callback_index[index] = (guint8) callback_count;
+}
+
 void flist_callback_init() {
-    if(callbacks) return;
-    callbacks = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+    if(callback_count) return;
     
     //TODO:
             //HLO - server MOTD
             //KIN - kinks data
             //VAR - server variables
     
-    g_hash_table_insert(callbacks, "WSH", flist_process_WSH);
+    flist_callback_register("WSH", flist_process_WSH);
     
-    g_hash_table_insert(callbacks, "RTB", flist_process_RTB);
+    flist_callback_register("RTB", flist_process_RTB);
     
     
-    g_hash_table_insert(callbacks, "TPN", flist_process_TPN);
+    flist_callback_register("TPN", flist_process_TPN);
     
     /* info on admins */
-    g_hash_table_insert(callbacks, "ADL", flist_process_ADL);
-    g_hash_table_insert(callbacks, "AOP", flist_process_AOP);
-    g_hash_table_insert(callbacks, "DOP", flist_process_DOP);
+    flist_callback_register("ADL", flist_process_ADL);
+    flist_callback_register("AOP", flist_process_AOP);
+    flist_callback_register("DOP", flist_process_DOP);
 
     /* admin broadcast */
-    g_hash_table_insert(callbacks, "BRO", flist_process_BRO);
+    flist_callback_register("BRO", flist_process_BRO);
 
     /* system message */
-    g_hash_table_insert(callbacks, "SYS", flist_process_SYS);
+    flist_callback_register("SYS", flist_process_SYS);
     
     //TODO: write RLL its own function
-    g_hash_table_insert(callbacks, "RLL", flist_process_MSG);
+    flist_callback_register("RLL", flist_process_MSG);
 
     /* kink search */
-    g_hash_table_insert(callbacks, "FKS", flist_process_FKS);
+    flist_callback_register("FKS", flist_process_FKS);
 
-    g_hash_table_insert(callbacks, "PIN", flist_process_PIN);
-    g_hash_table_insert(callbacks, "ERR", flist_process_ERR);
+    flist_callback_register("PIN", flist_process_PIN);
+    flist_callback_register("ERR", flist_process_ERR);
 
-    g_hash_table_insert(callbacks, "IDN", flist_process_IDN);
-    g_hash_table_insert(callbacks, "PRI", flist_process_PRI);
-    g_hash_table_insert(callbacks, "LIS", flist_process_LIS);
-    g_hash_table_insert(callbacks, "CON", flist_process_CON);
-    g_hash_table_insert(callbacks, "NLN", flist_process_NLN);
-    g_hash_table_insert(callbacks, "STA", flist_process_STA);
-    g_hash_table_insert(callbacks, "FLN", flist_process_FLN);
+    flist_callback_register("IDN", flist_process_IDN);
+    flist_callback_register("PRI", flist_process_PRI);
+    flist_callback_register("LIS", flist_process_LIS);
+    flist_callback_register("CON", flist_process_CON);
+    flist_callback_register("NLN", flist_process_NLN);
+    flist_callback_register("STA", flist_process_STA);
+    flist_callback_register("FLN", flist_process_FLN);
     
     //profile request
-    g_hash_table_insert(callbacks, "PRD", flist_process_PRD);
+    flist_callback_register("PRD", flist_process_PRD);
     
     //channel list callbacks
-    g_hash_table_insert(callbacks, "CHA", flist_process_CHA); //public channel list
-    g_hash_table_insert(callbacks, "ORS", flist_process_ORS); //private channel list
+    flist_callback_register("CHA", flist_process_CHA); //public channel list
+    flist_callback_register("ORS", flist_process_ORS); //private channel list
     
     //channel event callbacks
-    g_hash_table_insert(callbacks, "COL", flist_process_COL); //op list
-    g_hash_table_insert(callbacks, "JCH", flist_process_JCH); //join channel
-    g_hash_table_insert(callbacks, "LCH", flist_process_LCH); //leave channel
-    g_hash_table_insert(callbacks, "CBU", flist_process_CBU); //channel ban
-    g_hash_table_insert(callbacks, "CKU", flist_process_CKU); //channel kick
-    g_hash_table_insert(callbacks, "ICH", flist_process_ICH); //in channel
-    g_hash_table_insert(callbacks, "MSG", flist_process_MSG); //channel message
-    g_hash_table_insert(callbacks, "LRP", flist_process_LRP); //channel ad
-    g_hash_table_insert(callbacks, "CDS", flist_process_CDS);
-    g_hash_table_insert(callbacks, "CIU", flist_process_CIU); //channel invite
+    flist_callback_register("COL", flist_process_COL); //op list
+    flist_callback_register("JCH", flist_process_JCH); //join channel
+    flist_callback_register("LCH", flist_process_LCH); //leave channel
+    flist_callback_register("CBU", flist_process_CBU); //channel ban
+    flist_callback_register("CKU", flist_process_CKU); //channel kick
+    flist_callback_register("ICH", flist_process_ICH); //in channel
+    flist_callback_register("MSG", flist_process_MSG); //channel message
+    flist_callback_register("LRP", flist_process_LRP); //channel ad
+    flist_callback_register("CDS", flist_process_CDS);
+    flist_callback_register("CIU", flist_process_CIU); //channel invite
 
     //staff call
-    g_hash_table_insert(callbacks, "SFC", flist_process_SFC);
+    flist_callback_register("SFC", flist_process_SFC);
 }
@@ -24,5 +24,8 @@
 #include "f-list.h"
 
 gboolean flist_callback(PurpleConnection *, const gchar *, JsonObject *);
+/* returns FALSE if the frame has to go through flist_callback instead */
+gboolean flist_callback_fast(PurpleConnection *, const gchar *code, const gchar *data, gsize len);
+void flist_callback_stats(FListAccount *, GString *);
 void flist_callback_init();
 #endif
@@ -21,83 +21,147 @@
 #include "f-list_channels.h"
 #define CHAT_SHOW_DISPLAY_STATUS "CHAT_SHOW_DISPLAY_STATUS"
 
-GCompareFunc flist_op_strcmp = (GCompareFunc) flist_strcmp;
-
 FListFlags flist_get_flags(FListAccount *fla, const gchar *channel, const gchar *identity) {
     FListFlags ret = 0;
     FListChannel *fchannel = channel ? flist_channel_find(fla, channel) : NULL;
+    guint id = flist_name_id(fla->names, identity);
     
-    if(fchannel && fchannel->owner && !flist_op_strcmp(fchannel->owner, identity)) {
+    if(!id) return ret; /* we have never heard of them */
+    if(fchannel && fchannel->owner == id) {
         ret |= FLIST_FLAG_CHANNEL_FOUNDER;
     }
-    if(fchannel && g_list_find_custom(fchannel->operators, identity, flist_op_strcmp)) {
+    if(fchannel && g_hash_table_lookup_extended(fchannel->operators, GUINT_TO_POINTER(id), NULL, NULL)) {
         ret |= FLIST_FLAG_CHANNEL_OP;
     }
-    if(g_hash_table_lookup(fla->global_ops, identity) != NULL) {
+    if(g_hash_table_lookup(fla->global_ops, GUINT_TO_POINTER(id)) != NULL) {
         ret |= FLIST_FLAG_GLOBAL_OP;
         ret |= FLIST_FLAG_ADMIN; /* there is currently no way to tell */
     }
     return ret;
 }
 
-static PurpleConvChatBuddyFlags flist_flags_lookup(FListAccount *fla, PurpleConversation *convo, const gchar *identity) {
+static PurpleConvChatBuddyFlags flist_flags_lookup_id(FListAccount *fla, PurpleConversation *convo, guint id) {
     const gchar *channel = purple_conversation_get_name(convo);
     FListChannel *fchannel = flist_channel_find(fla, channel);
     
     if(!fchannel) {
-        purple_debug_error("flist", "Flags requested for %s in channel %s, but no channel was found.\n", identity, channel);
+        purple_debug_error("flist", "Flags requested for %s in channel %s, but no channel was found.\n", flist_name_get(fla->names, id), channel);
         return PURPLE_CBFLAGS_NONE;
     }
-    if(fchannel->owner && !flist_op_strcmp(fchannel->owner, identity)) {
+    if(fchannel->owner == id) {
         return PURPLE_CBFLAGS_FOUNDER;
     }
-    if(g_hash_table_lookup(fla->global_ops, identity) != NULL) {
+    if(g_hash_table_lookup(fla->global_ops, GUINT_TO_POINTER(id)) != NULL) {
         return PURPLE_CBFLAGS_OP;
     }
-    if(g_list_find_custom(fchannel->operators, identity, flist_op_strcmp)) {
+    if(g_hash_table_lookup_extended(fchannel->operators, GUINT_TO_POINTER(id), NULL, NULL)) {
         return PURPLE_CBFLAGS_HALFOP;
     }
     
     return PURPLE_CBFLAGS_NONE;
 }
 
-void flist_update_user_chats_offline(PurpleConnection *pc, const gchar *character) {
-    FListAccount *fla = pc->proto_data;
-    PurpleAccount *pa = fla->pa;
-    FListChannel *fchannel;
+static PurpleConvChatBuddyFlags flist_flags_lookup(FListAccount *fla, PurpleConversation *convo, const gchar *identity) {
+    guint id = flist_name_id(fla->names, identity);
+    if(!id) return PURPLE_CBFLAGS_NONE;
+    return flist_flags_lookup_id(fla, convo, id);
+}
+
+/* Channel membership is kept both ways: each channel has a set of user IDs, */
+/* and each online character has a list of the channels they are in. */
+static void flist_channel_add_user(FListAccount *fla, FListChannel *fchannel, guint id) {
+    FListCharacter *character;
+
+    if(g_hash_table_lookup_extended(fchannel->users, GUINT_TO_POINTER(id), NULL, NULL)) return;
+    g_hash_table_insert(fchannel->users, GUINT_TO_POINTER(id), NULL);
+    character = flist_character_get_by_id(fla, id);
+    if(character) character->channels = g_slist_prepend(character->channels, fchannel);
+}
+
+static void flist_channel_remove_user(FListAccount *fla, FListChannel *fchannel, guint id) {
+    FListCharacter *character = flist_character_get_by_id(fla, id);
+
+    g_hash_table_remove(fchannel->users, GUINT_TO_POINTER(id));
+    if(character) character->channels = g_slist_remove(character->channels, fchannel);
+}
+
+/* called before a channel is dropped, so that no character points at it */
+static void flist_channel_remove_all_users(FListAccount *fla, FListChannel *fchannel) {
     GHashTableIter iter;
-    g_hash_table_iter_init(&iter, fla->chat_table);
+    gpointer id;
 
-    while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&fchannel)) {
-        gchar *original_character;
-        if(g_hash_table_lookup_extended(fchannel->users, character, (void**) &original_character, NULL)) {
-            PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, fchannel->name, pa);
-            if(convo) purple_conv_chat_remove_user(PURPLE_CONV_CHAT(convo), original_character, "offline");
-            g_hash_table_remove(fchannel->users, character);
-        }
+    g_hash_table_iter_init(&iter, fchannel->users);
+    while(g_hash_table_iter_next(&iter, &id, NULL)) {
+        FListCharacter *character = flist_character_get_by_id(fla, GPOINTER_TO_UINT(id));
+        if(character) character->channels = g_slist_remove(character->channels, fchannel);
     }
+    g_hash_table_remove_all(fchannel->users);
 }
 
-void flist_update_user_chats_rank(PurpleConnection *pc, const gchar *character) {
-    FListAccount *fla = pc->proto_data;
-    PurpleAccount *pa = fla->pa;
-    FListChannel *channel;
+/* A user can be listed in a channel before we have a record for them, so */
+/* nothing links them to it; for them, every channel has to be checked. */
+static void flist_update_user_chats_offline_scan(FListAccount *fla, const gchar *identity) {
+    guint id = flist_name_id(fla->names, identity);
     GHashTableIter iter;
+    gpointer value;
+
+    if(!id) return;
     g_hash_table_iter_init(&iter, fla->chat_table);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        FListChannel *fchannel = value;
+        PurpleConversation *convo;
+        if(!g_hash_table_remove(fchannel->users, GUINT_TO_POINTER(id))) continue;
+        convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, fchannel->name, fla->pa);
+        if(convo) purple_conv_chat_remove_user(PURPLE_CONV_CHAT(convo), flist_name_get(fla->names, id), "offline");
+    }
+}
 
-    while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&channel)) {
-        if(g_hash_table_lookup_extended(channel->users, character, NULL, NULL)) {
-            PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel->name, pa);
-            PurpleConvChatBuddyFlags flags = flist_flags_lookup(fla, convo, character);
-            purple_conv_chat_user_set_flags(PURPLE_CONV_CHAT(convo), character, flags);
-        }
+/* this has to happen before the character record is removed */
+void flist_update_user_chats_offline(PurpleConnection *pc, const gchar *identity) {
+    FListAccount *fla = pc->proto_data;
+    PurpleAccount *pa = fla->pa;
+    FListCharacter *character = flist_get_character(fla, identity);
+    GSList *cur;
+
+    if(!character) {
+        flist_update_user_chats_offline_scan(fla, identity);
+        return;
+    }
+    for(cur = character->channels; cur; cur = g_slist_next(cur)) {
+        FListChannel *fchannel = cur->data;
+        PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, fchannel->name, pa);
+        if(convo) purple_conv_chat_remove_user(PURPLE_CONV_CHAT(convo), character->name, "offline");
+        g_hash_table_remove(fchannel->users, GUINT_TO_POINTER(character->id));
+    }
+    g_slist_free(character->channels);
+    character->channels = NULL;
+}
+
+static void flist_update_user_chats_rank_id(FListAccount *fla, guint id) {
+    PurpleAccount *pa = fla->pa;
+    FListCharacter *character = flist_character_get_by_id(fla, id);
+    GSList *cur;
+
+    if(!character) return;
+    for(cur = character->channels; cur; cur = g_slist_next(cur)) {
+        FListChannel *channel = cur->data;
+        PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel->name, pa);
+        PurpleConvChatBuddyFlags flags = flist_flags_lookup_id(fla, convo, id);
+        purple_conv_chat_user_set_flags(PURPLE_CONV_CHAT(convo), character->name, flags);
     }
 }
 
-void flist_update_users_chats_rank(PurpleConnection *pc, GList *users) {
-    GList *cur = users;
+void flist_update_user_chats_rank(PurpleConnection *pc, const gchar *character) {
+    FListAccount *fla = pc->proto_data;
+    guint id = flist_name_id(fla->names, character);
+    if(id) flist_update_user_chats_rank_id(fla, id);
+}
+
+void flist_update_users_chats_rank(PurpleConnection *pc, GList *ids) {
+    FListAccount *fla = pc->proto_data;
+    GList *cur = ids;
     while(cur) {
-        flist_update_user_chats_rank(pc, cur->data);
+        flist_update_user_chats_rank_id(fla, GPOINTER_TO_UINT(cur->data));
         cur = g_list_next(cur);
     }
 }
@@ -168,8 +232,9 @@ void flist_got_channel_userlist(FListAccount *fla, const gchar *channel, GList *
     g_return_if_fail(fchannel != NULL);
     
     for(cur = userlist; cur; cur = cur->next) {
-        flags = g_list_prepend(flags, GINT_TO_POINTER(flist_flags_lookup(fla, convo, cur->data)));
-        g_hash_table_replace(fchannel->users, g_strdup(cur->data), NULL);
+        guint id = flist_name_intern(fla->names, cur->data);
+        flags = g_list_prepend(flags, GINT_TO_POINTER(flist_flags_lookup_id(fla, convo, id)));
+        flist_channel_add_user(fla, fchannel, id);
     }
     flags = g_list_reverse(flags);
     
@@ -180,43 +245,57 @@ void flist_got_channel_user_joined(FListAccount *fla, const gchar *channel, cons
     PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel, fla->pa);
     FListChannel *fchannel = flist_channel_find(fla, channel);
     PurpleConvChatBuddyFlags flags;
+    guint id;
 
     g_return_if_fail(character != NULL);
     g_return_if_fail(fchannel != NULL);
     g_return_if_fail(convo != NULL);
     
-    g_hash_table_replace(fchannel->users, g_strdup(character), NULL);
+    id = flist_name_intern(fla->names, character);
+    flist_channel_add_user(fla, fchannel, id);
     
-    flags = flist_flags_lookup(fla, convo, character);
+    flags = flist_flags_lookup_id(fla, convo, id);
     purple_conv_chat_add_user(PURPLE_CONV_CHAT(convo), character, NULL, flags, TRUE);
+    flist_filter_character_changed(fla, flist_get_character(fla, character));
 }
 
 void flist_got_channel_user_left(FListAccount *fla, const gchar *channel, const gchar* character, const gchar* message) {
     PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel, fla->pa);
     FListChannel *fchannel = flist_channel_find(fla, channel);
-    gchar *original_character;
+    guint id;
     
     g_return_if_fail(character != NULL);
     g_return_if_fail(fchannel != NULL);
     g_return_if_fail(convo != NULL);
     
-    if(g_hash_table_lookup_extended(fchannel->users, character, (void**) &original_character, NULL)) {
-        purple_conv_chat_remove_user(PURPLE_CONV_CHAT(convo), original_character, message ? message : "left");
-        g_hash_table_remove(fchannel->users, character);
+    id = flist_name_id(fla->names, character);
+    if(id && g_hash_table_lookup_extended(fchannel->users, GUINT_TO_POINTER(id), NULL, NULL)) {
+        purple_conv_chat_remove_user(PURPLE_CONV_CHAT(convo), flist_name_get(fla->names, id), message ? message : "left");
+        flist_channel_remove_user(fla, fchannel, id);
+        flist_filter_character_changed(fla, flist_get_character(fla, character));
     }
 }
 
 void flist_got_channel_joined(FListAccount *fla, const gchar *name) {
-    FListChannel *fchannel = g_new0(FListChannel, 1);
+    FListChannel *fchannel = flist_channel_find(fla, name);
     
+    if(fchannel) flist_channel_remove_all_users(fla, fchannel); /* it's about to be replaced */
+    fchannel = g_new0(FListChannel, 1);
     fchannel->name = g_strdup(name);
-    fchannel->users = g_hash_table_new_full((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal, g_free, NULL);
+    fchannel->users = g_hash_table_new(g_direct_hash, g_direct_equal);
+    fchannel->operators = g_hash_table_new(g_direct_hash, g_direct_equal);
     fchannel->mode = CHANNEL_MODE_BOTH;
+    fchannel->show_chat = flist_get_channel_show_chat(fla, name);
+    fchannel->show_ads = flist_get_channel_show_ads(fla, name);
     g_hash_table_replace(fla->chat_table, g_strdup(name), fchannel);
     purple_debug(PURPLE_DEBUG_INFO, "flist", "We (%s) have joined channel %s.\n", fla->proper_character, name);
 }
 
 void flist_got_channel_left(FListAccount *fla, const gchar *name) {
+    FListChannel *fchannel = flist_channel_find(fla, name);
+    
+    flist_filter_channel_left(fla, name);
+    if(fchannel) flist_channel_remove_all_users(fla, fchannel);
     flist_remove_chat(fla, name);
     g_hash_table_remove(fla->chat_table, name);
     purple_debug(PURPLE_DEBUG_INFO, "flist", "We (%s) have left channel %s.\n", fla->proper_character, name);
@@ -237,30 +316,48 @@ void flist_got_channel_mode(FListAccount *fla, const gchar *channel, const gchar
 void flist_got_channel_oplist(FListAccount *fla, const gchar *channel, GList *ops) {
     PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channel, fla->pa);
     FListChannel *fchannel = flist_channel_find(fla, channel);
-    GList *old_ops, *new_ops;
-    gchar *old_owner;
+    GHashTable *old_ops, *new_ops;
+    guint old_owner, owner = 0;
+    GHashTableIter iter;
+    gpointer id;
+    GList *cur;
     
     g_return_if_fail(fchannel != NULL);
     g_return_if_fail(convo != NULL);
     
     old_ops = fchannel->operators;
     old_owner = fchannel->owner;
-    new_ops = NULL;
-    
-    for(; ops; ops = ops->next) {
-        gchar *identity = g_strdup(ops->data);
-        new_ops = g_list_prepend(new_ops, identity);
+    new_ops = g_hash_table_new(g_direct_hash, g_direct_equal);
+    
+    /* the owner comes first, and is an empty string if there is none */
+    for(cur = ops; cur; cur = cur->next) {
+        const gchar *identity = cur->data;
+        if(cur == ops) {
+            if(*identity) owner = flist_name_intern(fla->names, identity);
+        } else {
+            g_hash_table_replace(new_ops, GUINT_TO_POINTER(flist_name_intern(fla->names, identity)), NULL);
+        }
     }
-    new_ops = g_list_reverse(new_ops);
+    if(owner) g_hash_table_remove(new_ops, GUINT_TO_POINTER(owner));
     
     fchannel->operators = new_ops;
-    fchannel->owner = new_ops ? g_strdup(new_ops->data) : NULL;
+    fchannel->owner = owner;
     
-    flist_update_users_chats_rank(fla->pc, old_ops);
-    flist_update_users_chats_rank(fla->pc, fchannel->operators);
+    /* only the characters whose rank changed need new flags */
+    g_hash_table_iter_init(&iter, old_ops);
+    while(g_hash_table_iter_next(&iter, &id, NULL)) {
+        if(!g_hash_table_lookup_extended(new_ops, id, NULL, NULL)) flist_update_user_chats_rank_id(fla, GPOINTER_TO_UINT(id));
+    }
+    g_hash_table_iter_init(&iter, new_ops);
+    while(g_hash_table_iter_next(&iter, &id, NULL)) {
+        if(!g_hash_table_lookup_extended(old_ops, id, NULL, NULL)) flist_update_user_chats_rank_id(fla, GPOINTER_TO_UINT(id));
+    }
+    if(old_owner != owner) {
+        if(old_owner) flist_update_user_chats_rank_id(fla, old_owner);
+        if(owner) flist_update_user_chats_rank_id(fla, owner);
+    }
     
-    if(old_owner) g_free(old_owner);
-    if(old_ops) flist_g_list_free_full(old_ops, g_free);
+    g_hash_table_destroy(old_ops);
 }
 
 /*
@@ -522,26 +619,25 @@ PurpleCmdRet flist_channel_oplist_cmd(PurpleConversation *convo, const gchar *cm
     FListChannel *fchannel = flist_channel_find(fla, name);
     GString *str;
     gchar *to_print;
-    GList *cur;
+    GHashTableIter iter;
+    gpointer id;
     
     g_return_val_if_fail(fchannel != NULL, PURPLE_CMD_STATUS_OK);
     
     str = g_string_new(NULL);
-    if(!fchannel->owner && !fchannel->operators) {
+    if(!fchannel->owner && g_hash_table_size(fchannel->operators) == 0) {
         g_string_append(str, "This channel has no operators.");
     } else {
         gboolean first = TRUE;
         g_string_append(str, "The operators for this channel are: ");
         if(fchannel->owner) {
             first = FALSE;
-            g_string_append_printf(str, "%s (Owner)", fchannel->owner);
+            g_string_append_printf(str, "%s (Owner)", flist_name_get(fla->names, fchannel->owner));
         }
-        for(cur = fchannel->operators; cur; cur = cur->next) {
-            const gchar *character = (const gchar *) cur->data;
-            if(!fchannel->owner || !flist_str_equal(character, fchannel->owner)) {
-                g_string_append_printf(str, "%s%s", !first ? ", " : "", character);
-                first = FALSE;
-            }
+        g_hash_table_iter_init(&iter, fchannel->operators);
+        while(g_hash_table_iter_next(&iter, &id, NULL)) {
+            g_string_append_printf(str, "%s%s", !first ? ", " : "", flist_name_get(fla->names, GPOINTER_TO_UINT(id)));
+            first = FALSE;
         }
     }
 
@@ -800,9 +896,8 @@ PurpleCmdRet flist_channel_invite_cmd(PurpleConversation *convo, const gchar *cm
 static void flist_channel_destroy(void *p) {
     FListChannel *fchannel = (FListChannel *) p;
     g_free(fchannel->name);
-    if(fchannel->owner) g_free(fchannel->owner);
     if(fchannel->topic) g_free(fchannel->topic);
-    flist_g_list_free_full(fchannel->operators, g_free);
+    g_hash_table_destroy(fchannel->operators);
     g_hash_table_destroy(fchannel->users);
 }
 
@@ -823,11 +918,42 @@ GList *flist_channel_list_names(FListAccount *fla) {
     return g_hash_table_get_keys(fla->chat_table);
 }
 
+/* for flist_names_collect: every ID a channel keeps */
+void flist_channels_mark_names(FListAccount *fla, FListBitset *keep) {
+    GHashTableIter iter, id_iter;
+    FListChannel *fchannel;
+    gpointer id;
+
+    g_hash_table_iter_init(&iter, fla->chat_table);
+    while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&fchannel)) {
+        if(fchannel->owner) flist_bitset_add(keep, fchannel->owner);
+        g_hash_table_iter_init(&id_iter, fchannel->users);
+        while(g_hash_table_iter_next(&id_iter, &id, NULL)) flist_bitset_add(keep, GPOINTER_TO_UINT(id));
+        g_hash_table_iter_init(&id_iter, fchannel->operators);
+        while(g_hash_table_iter_next(&id_iter, &id, NULL)) flist_bitset_add(keep, GPOINTER_TO_UINT(id));
+    }
+}
+
 void flist_channel_subsystem_load(FListAccount *fla) {
     fla->chat_timestamp = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     fla->chat_table = g_hash_table_new_full((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal, g_free, (GDestroyNotify) flist_channel_destroy);
 }
 
+void flist_channel_stats(FListAccount *fla, GString *str) {
+    GHashTableIter iter;
+    FListChannel *fchannel;
+
+    g_hash_table_iter_init(&iter, fla->chat_table);
+    while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&fchannel)) {
+        gchar *title;
+        if(!fchannel->hidden_messages && !fchannel->hidden_ads) continue;
+        title = g_markup_escape_text(flist_channel_get_title(fchannel), -1);
+        g_string_append_printf(str, "Hidden in %s: %u messages, %u ads<br>",
+            title, fchannel->hidden_messages, fchannel->hidden_ads);
+        g_free(title);
+    }
+}
+
 void flist_channel_subsystem_unload(FListAccount *fla) {
     g_hash_table_destroy(fla->chat_timestamp);
     g_hash_table_destroy(fla->chat_table);
@@ -28,11 +28,13 @@ typedef struct FListChannel_ FListChannel;
 struct FListChannel_ {
     gchar *name;
     gchar *title;
-    GHashTable *users;
-    gchar *owner;
-    GList *operators;
+    GHashTable *users; /* set of character IDs */
+    guint owner; /* character ID, 0 if there is none */
+    GHashTable *operators; /* set of character IDs, not including the owner */
     FListChannelMode mode;
     gchar *topic;
+    gboolean show_chat, show_ads; /* copies of the buddy list settings */
+    guint hidden_messages, hidden_ads; /* dropped without being displayed */
 };
 
 FListFlags flist_get_flags(FListAccount *, const gchar *channel, const gchar *identity);
@@ -41,7 +43,7 @@ void flist_channel_print_error(PurpleConversation *convo, const gchar *message);
 
 void flist_update_user_chats_offline(PurpleConnection *, const gchar *);
 void flist_update_user_chats_rank(PurpleConnection *, const gchar *);
-void flist_update_users_chats_rank(PurpleConnection *, GList *);
+void flist_update_users_chats_rank(PurpleConnection *, GList *ids);
 
 void flist_got_channel_joined(FListAccount *, const gchar *);
 void flist_got_channel_left(FListAccount *, const gchar *);
@@ -57,8 +59,10 @@ const gchar *flist_channel_get_title(FListChannel *);
 GList *flist_channel_list_names(FListAccount *);
 GList *flist_channel_list_all(FListAccount *);
 
+void flist_channels_mark_names(FListAccount *, FListBitset *keep);
 void flist_channel_subsystem_load(FListAccount*);
 void flist_channel_subsystem_unload(FListAccount*);
+void flist_channel_stats(FListAccount *, GString *);
 
 PurpleCmdRet flist_channel_code_cmd(PurpleConversation *, const gchar *, gchar **args, gchar **error, void *);
 PurpleCmdRet flist_channel_oplist_cmd(PurpleConversation *, const gchar *, gchar **args, gchar **error, void *);
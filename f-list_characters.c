@@ -0,0 +1,459 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "f-list_characters.h"
+
+/* character records are handed out from slabs of this many */
+#define FLIST_CHARACTER_SLAB_SIZE 512
+/* names that fit in a cell share the arena; longer ones get their own */
+#define FLIST_NAME_CELL_SIZE 32
+/* don't bother collecting names while there are fewer than this */
+#define FLIST_NAMES_COLLECT_MIN 1024
+
+typedef union FListCharacterSlot_ FListCharacterSlot;
+typedef struct FListCharacterSlab_ FListCharacterSlab;
+typedef union FListNameCell_ FListNameCell;
+
+union FListNameCell_ {
+    gchar text[FLIST_NAME_CELL_SIZE];
+    FListNameCell *next_free;
+};
+
+struct FListNames_ {
+    GHashTable *ids; /* name to ID, ignoring case; the keys are the canonical names */
+    GPtrArray *names; /* ID to canonical name, NULL if the ID is free; ID 0 is never handed out */
+    GArray *free_ids; /* collected IDs, taken from the end */
+    FListArena *strings; /* the cells that hold canonical names */
+    FListNameCell *free_cells;
+    guint count; /* IDs in use */
+    guint collect_at; /* collect again once count gets here */
+    guint collections;
+    guint64 collected;
+    gsize bytes;
+};
+
+union FListCharacterSlot_ {
+    FListCharacter character;
+    FListCharacterSlot *next_free;
+};
+
+struct FListCharacterSlab_ {
+    FListCharacterSlab *next;
+    FListCharacterSlot slots[FLIST_CHARACTER_SLAB_SIZE];
+};
+
+/* Status messages are shared between every character that has the same */
+/* one; most of them are empty or one of a few common texts. */
+struct FListStatusMessage_ {
+    guint refs;
+    gchar *escaped; /* made the first time something displays it */
+    gchar text[];
+};
+
+struct FListCharacterPool_ {
+    FListCharacterSlab *slabs; /* the slab we're carving from comes first */
+    guint carved; /* slots of the first slab that have been handed out at least once */
+    FListCharacterSlot *free; /* records that were freed, for reuse */
+    FListCharacterSlab *spare; /* reserved slabs that haven't been carved yet */
+    guint slab_count;
+    guint in_use;
+};
+
+FListNames *flist_names_new() {
+    FListNames *names = g_new0(FListNames, 1);
+    names->ids = g_hash_table_new((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal);
+    names->names = g_ptr_array_sized_new(1024);
+    names->free_ids = g_array_new(FALSE, FALSE, sizeof(guint));
+    names->strings = flist_arena_new();
+    names->collect_at = FLIST_NAMES_COLLECT_MIN;
+    g_ptr_array_add(names->names, NULL);
+    return names;
+}
+
+static gboolean flist_name_in_cell(gsize len) {
+    return len + 1 <= FLIST_NAME_CELL_SIZE;
+}
+
+void flist_names_free(FListNames *names) {
+    guint id;
+
+    for(id = 1; id < names->names->len; id++) {
+        gchar *name = g_ptr_array_index(names->names, id);
+        if(name && !flist_name_in_cell(strlen(name))) g_free(name);
+    }
+    g_hash_table_destroy(names->ids);
+    g_ptr_array_free(names->names, TRUE);
+    g_array_free(names->free_ids, TRUE);
+    flist_arena_free(names->strings);
+    g_free(names);
+}
+
+guint flist_name_intern(FListNames *names, const gchar *name) {
+    gpointer id;
+    gchar *canonical;
+    gsize len;
+
+    g_return_val_if_fail(name != NULL, 0);
+
+    if(g_hash_table_lookup_extended(names->ids, name, NULL, &id)) {
+        return GPOINTER_TO_UINT(id);
+    }
+    len = strlen(name);
+    if(flist_name_in_cell(len)) {
+        FListNameCell *cell = names->free_cells;
+        if(cell) {
+            names->free_cells = cell->next_free;
+        } else {
+            cell = flist_arena_alloc(names->strings, sizeof(FListNameCell));
+        }
+        canonical = cell->text;
+        memcpy(canonical, name, len + 1);
+    } else {
+        canonical = g_strndup(name, len);
+    }
+    if(names->free_ids->len > 0) {
+        id = GUINT_TO_POINTER(g_array_index(names->free_ids, guint, names->free_ids->len - 1));
+        g_array_set_size(names->free_ids, names->free_ids->len - 1);
+        g_ptr_array_index(names->names, GPOINTER_TO_UINT(id)) = canonical;
+    } else {
+        g_ptr_array_add(names->names, canonical);
+        id = GUINT_TO_POINTER(names->names->len - 1);
+    }
+    g_hash_table_insert(names->ids, canonical, id);
+    names->count++;
+    names->bytes += len + 1;
+    return GPOINTER_TO_UINT(id);
+}
+
+static void flist_name_release(FListNames *names, guint id) {
+    gchar *name = g_ptr_array_index(names->names, id);
+    gsize len = strlen(name);
+
+    g_hash_table_remove(names->ids, name);
+    if(flist_name_in_cell(len)) {
+        FListNameCell *cell = (FListNameCell *) name;
+        cell->next_free = names->free_cells;
+        names->free_cells = cell;
+    } else {
+        g_free(name);
+    }
+    g_ptr_array_index(names->names, id) = NULL;
+    g_array_append_val(names->free_ids, id);
+    names->count--;
+    names->bytes -= len + 1;
+}
+
+guint flist_name_id(FListNames *names, const gchar *name) {
+    if(!name) return 0;
+    return GPOINTER_TO_UINT(g_hash_table_lookup(names->ids, name));
+}
+
+const gchar *flist_name_get(FListNames *names, guint id) {
+    g_return_val_if_fail(id < names->names->len, NULL);
+    return g_ptr_array_index(names->names, id);
+}
+
+/* Frees the names no one refers to any more. Everything that keeps an ID */
+/* marks it: the character records (through online_set), the channels, the */
+/* global ops, the friends list and a live search. This is only safe where */
+/* no ID is held anywhere else, such as in a local variable. */
+static void flist_names_collect(FListAccount *fla) {
+    FListNames *names = fla->names;
+    FListBitset *keep = flist_bitset_new();
+    GHashTableIter iter;
+    gpointer key;
+    guint id, before = names->count;
+
+    flist_bitset_copy(keep, fla->online_set);
+    if(fla->global_ops) {
+        g_hash_table_iter_init(&iter, fla->global_ops);
+        while(g_hash_table_iter_next(&iter, &key, NULL)) flist_bitset_add(keep, GPOINTER_TO_UINT(key));
+    }
+    flist_channels_mark_names(fla, keep);
+    flist_friends_mark_names(fla, keep);
+    flist_filter_mark_names(fla, keep);
+
+    /* going down, so that the lowest free ID is reused first */
+    for(id = names->names->len - 1; id > 0; id--) {
+        if(g_ptr_array_index(names->names, id) && !flist_bitset_contains(keep, id)) {
+            flist_name_release(names, id);
+        }
+    }
+    flist_bitset_free(keep);
+
+    names->collections++;
+    names->collected += before - names->count;
+    names->collect_at = MAX(names->count * 2, FLIST_NAMES_COLLECT_MIN);
+    purple_debug_info(FLIST_DEBUG, "Collected %u character names, %u are still in use.\n", before - names->count, names->count);
+}
+
+static FListCharacterPool *flist_character_pool_new() {
+    return g_new0(FListCharacterPool, 1);
+}
+
+static void flist_character_slabs_free(FListCharacterSlab *slab) {
+    while(slab) {
+        FListCharacterSlab *next = slab->next;
+        g_free(slab);
+        slab = next;
+    }
+}
+
+static void flist_character_pool_free(FListCharacterPool *pool) {
+    flist_character_slabs_free(pool->slabs);
+    flist_character_slabs_free(pool->spare);
+    g_free(pool);
+}
+
+/* makes sure count more records can be handed out without a malloc */
+static void flist_character_pool_reserve(FListCharacterPool *pool, guint count) {
+    FListCharacterSlab *slab;
+    guint available = pool->slabs ? FLIST_CHARACTER_SLAB_SIZE - pool->carved : 0;
+
+    for(slab = pool->spare; slab; slab = slab->next) available += FLIST_CHARACTER_SLAB_SIZE;
+    while(available < count) {
+        slab = g_new(FListCharacterSlab, 1);
+        slab->next = pool->spare;
+        pool->spare = slab;
+        pool->slab_count++;
+        available += FLIST_CHARACTER_SLAB_SIZE;
+    }
+}
+
+/* Freed records are reused first. Otherwise we take the next untouched */
+/* slot, and only go to the heap when the current slab is used up. */
+static FListCharacter *flist_character_pool_alloc(FListCharacterPool *pool) {
+    FListCharacterSlot *slot;
+
+    if(pool->free) {
+        slot = pool->free;
+        pool->free = slot->next_free;
+    } else {
+        if(!pool->slabs || pool->carved == FLIST_CHARACTER_SLAB_SIZE) {
+            FListCharacterSlab *slab = pool->spare;
+            if(slab) {
+                pool->spare = slab->next;
+            } else {
+                slab = g_new(FListCharacterSlab, 1);
+                pool->slab_count++;
+            }
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->carved = 0;
+        }
+        slot = &pool->slabs->slots[pool->carved++];
+    }
+    pool->in_use++;
+    memset(&slot->character, 0, sizeof(FListCharacter));
+    return &slot->character;
+}
+
+static void flist_character_pool_release(FListCharacterPool *pool, FListCharacter *character) {
+    FListCharacterSlot *slot = (FListCharacterSlot *) character;
+    slot->next_free = pool->free;
+    pool->free = slot;
+    pool->in_use--;
+}
+
+FListCharacter *flist_character_new(FListAccount *fla, const gchar *name) {
+    FListCharacter *character = flist_character_pool_alloc(fla->character_pool);
+    character->id = flist_name_intern(fla->names, name);
+    character->name = flist_name_get(fla->names, character->id);
+    return character;
+}
+
+static void flist_status_message_unref(FListAccount *fla, FListStatusMessage *message) {
+    if(--message->refs > 0) return;
+    g_hash_table_remove(fla->status_messages, message->text); /* this frees it */
+}
+
+static void flist_status_message_free(gpointer data) {
+    FListStatusMessage *message = data;
+    if(message->escaped) g_free(message->escaped);
+    g_free(message);
+}
+
+void flist_character_set_status_message(FListAccount *fla, FListCharacter *character, const gchar *text) {
+    FListStatusMessage *message;
+
+    if(!text) text = "";
+    message = g_hash_table_lookup(fla->status_messages, text);
+    if(!message) {
+        gsize len = strlen(text);
+        message = g_malloc(sizeof(FListStatusMessage) + len + 1);
+        message->refs = 0;
+        message->escaped = NULL;
+        memcpy(message->text, text, len + 1);
+        g_hash_table_insert(fla->status_messages, message->text, message);
+    }
+    message->refs++;
+    if(character->status_message) flist_status_message_unref(fla, character->status_message);
+    character->status_message = message;
+}
+
+const gchar *flist_character_get_status_message(FListCharacter *character) {
+    return character->status_message ? character->status_message->text : "";
+}
+
+const gchar *flist_character_get_status_message_escaped(FListCharacter *character) {
+    FListStatusMessage *message = character->status_message;
+
+    if(!message) return "";
+    if(!message->escaped) message->escaped = g_markup_escape_text(message->text, -1);
+    return message->escaped;
+}
+
+static void flist_character_free(FListAccount *fla, FListCharacter *character) {
+    if(character->status_message) flist_status_message_unref(fla, character->status_message);
+    g_slist_free(character->channels);
+    flist_character_pool_release(fla->character_pool, character);
+}
+
+static FListBitset *flist_gender_set(FListAccount *fla, FListGender gender) {
+    gint index = g_bit_nth_lsf(gender, -1);
+    if(index < 0 || index >= FLIST_GENDER_COUNT) return fla->gender_sets[FLIST_GENDER_COUNT - 1];
+    return fla->gender_sets[index];
+}
+
+static void flist_character_index(FListAccount *fla, FListCharacter *character) {
+    flist_bitset_add(fla->online_set, character->id);
+    flist_bitset_add(fla->status_sets[character->status], character->id);
+    flist_bitset_add(flist_gender_set(fla, character->gender), character->id);
+}
+
+static void flist_character_unindex(FListAccount *fla, FListCharacter *character) {
+    flist_bitset_remove(fla->online_set, character->id);
+    flist_bitset_remove(fla->status_sets[character->status], character->id);
+    flist_bitset_remove(flist_gender_set(fla, character->gender), character->id);
+}
+
+void flist_character_add(FListAccount *fla, FListCharacter *character) {
+    FListCharacter *old = g_hash_table_lookup(fla->all_characters, character->name);
+    g_hash_table_replace(fla->all_characters, (gpointer) character->name, character);
+    if(old) {
+        /* the channels they're in haven't changed */
+        character->channels = old->channels;
+        old->channels = NULL;
+        flist_character_unindex(fla, old);
+        flist_character_free(fla, old);
+    }
+    flist_character_index(fla, character);
+}
+
+void flist_character_remove(FListAccount *fla, const gchar *name) {
+    FListCharacter *character = g_hash_table_lookup(fla->all_characters, name);
+    if(!character) return;
+    g_hash_table_remove(fla->all_characters, name);
+    flist_character_unindex(fla, character);
+    flist_character_free(fla, character);
+
+    /* collecting at twice the names still in use keeps the cost per FLN flat */
+    if(fla->names->count >= fla->names->collect_at) flist_names_collect(fla);
+}
+
+void flist_character_set_status(FListAccount *fla, FListCharacter *character, FListStatus status) {
+    if(character->status == status) return;
+    flist_bitset_remove(fla->status_sets[character->status], character->id);
+    character->status = status;
+    flist_bitset_add(fla->status_sets[status], character->id);
+}
+
+void flist_characters_filter(FListAccount *fla, FListBitset *result, gboolean looking, guint genders) {
+    guint i;
+
+    flist_bitset_clear(result);
+    for(i = 0; i < FLIST_GENDER_COUNT; i++) {
+        if(genders & (1 << i)) flist_bitset_union(result, fla->gender_sets[i]);
+    }
+    if(looking) flist_bitset_intersect(result, fla->status_sets[FLIST_STATUS_LOOKING]);
+}
+
+FListCharacter *flist_character_get_by_id(FListAccount *fla, guint id) {
+    const gchar *name;
+
+    if(!flist_bitset_contains(fla->online_set, id)) return NULL;
+    name = flist_name_get(fla->names, id);
+    return name ? g_hash_table_lookup(fla->all_characters, name) : NULL;
+}
+
+/* called with the online count from CON, before the LIS snapshot arrives */
+void flist_characters_reserve(FListAccount *fla, guint count) {
+    FListNames *names = fla->names;
+    guint len = names->names->len;
+
+    flist_character_pool_reserve(fla->character_pool, count);
+    /* growing and shrinking again leaves the array with room for count more */
+    g_ptr_array_set_size(names->names, len + count);
+    g_ptr_array_set_size(names->names, len);
+}
+
+void flist_characters_load(FListAccount *fla) {
+    guint i;
+
+    fla->names = flist_names_new();
+    fla->character_pool = flist_character_pool_new();
+    fla->all_characters = g_hash_table_new((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal);
+    fla->status_messages = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, flist_status_message_free);
+    fla->online_set = flist_bitset_new();
+    for(i = 0; i < FLIST_STATUS_COUNT; i++) fla->status_sets[i] = flist_bitset_new();
+    for(i = 0; i < FLIST_GENDER_COUNT; i++) fla->gender_sets[i] = flist_bitset_new();
+}
+
+void flist_characters_unload(FListAccount *fla) {
+    guint i;
+
+    flist_bitset_free(fla->online_set);
+    for(i = 0; i < FLIST_STATUS_COUNT; i++) flist_bitset_free(fla->status_sets[i]);
+    for(i = 0; i < FLIST_GENDER_COUNT; i++) flist_bitset_free(fla->gender_sets[i]);
+    g_hash_table_destroy(fla->all_characters);
+    g_hash_table_destroy(fla->status_messages);
+    flist_character_pool_free(fla->character_pool);
+    flist_names_free(fla->names);
+}
+
+void flist_characters_stats(FListAccount *fla, GString *str) {
+    FListCharacterPool *pool = fla->character_pool;
+    GHashTableIter iter;
+    gpointer value;
+    guint refs = 0;
+    gsize bytes = 0, escaped = 0, index_bytes;
+    guint i;
+
+    g_hash_table_iter_init(&iter, fla->status_messages);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        FListStatusMessage *message = value;
+        refs += message->refs;
+        bytes += strlen(message->text) + 1;
+        if(message->escaped) escaped++;
+    }
+    index_bytes = flist_bitset_bytes(fla->online_set);
+    for(i = 0; i < FLIST_STATUS_COUNT; i++) index_bytes += flist_bitset_bytes(fla->status_sets[i]);
+    for(i = 0; i < FLIST_GENDER_COUNT; i++) index_bytes += flist_bitset_bytes(fla->gender_sets[i]);
+
+    g_string_append_printf(str, "Character names: %u (%" G_GSIZE_FORMAT " bytes), %u IDs free, %" G_GUINT64_FORMAT " collected in %u passes<br>",
+        fla->names->count, fla->names->bytes, fla->names->free_ids->len, fla->names->collected, fla->names->collections);
+    g_string_append_printf(str, "Character records: %u in use, %u slabs of %u (%u never used)<br>",
+        pool->in_use, pool->slab_count, FLIST_CHARACTER_SLAB_SIZE,
+        pool->slabs ? FLIST_CHARACTER_SLAB_SIZE - pool->carved : 0);
+    g_string_append_printf(str, "Status messages: %u shared by %u characters (%" G_GSIZE_FORMAT " bytes, %" G_GSIZE_FORMAT " escaped for display)<br>",
+        g_hash_table_size(fla->status_messages), refs, bytes, escaped);
+    g_string_append_printf(str, "Character index: %u online, %u looking (%" G_GSIZE_FORMAT " bytes)<br>",
+        flist_bitset_count(fla->online_set), flist_bitset_count(fla->status_sets[FLIST_STATUS_LOOKING]), index_bytes);
+}
@@ -0,0 +1,69 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLIST_CHARACTERS_H
+#define	FLIST_CHARACTERS_H
+
+#include "f-list.h"
+
+/* Every character name we see gets a small integer ID, and one canonical */
+/* copy of the name. IDs start at 1, so 0 always means "not a name we */
+/* know". When an FLN leaves twice as many names as were in use after the */
+/* last collection, the names that no record, channel, op list, friend or */
+/* live search refers to are freed, and their IDs are reused. So the table, */
+/* and every set indexed by ID, stays about as big as the peak number */
+/* online (see "Character names" in /debugstats). */
+FListNames *flist_names_new();
+void flist_names_free(FListNames *);
+
+/* Only for names from the server, as the first spelling we see is kept. */
+/* An ID is only safe to keep where flist_names_collect marks it; anything */
+/* new that stores IDs has to be added there. Names the user typed are */
+/* looked up with flist_name_id, and unknown ones don't get an ID. */
+guint flist_name_intern(FListNames *, const gchar *name);
+guint flist_name_id(FListNames *, const gchar *name);
+const gchar *flist_name_get(FListNames *, guint id);
+
+/* Character records come from a per-connection pool. A new record only */
+/* goes into all_characters with flist_character_add(), which replaces */
+/* (and frees) any record of the same name. */
+FListCharacter *flist_character_new(FListAccount *, const gchar *name);
+void flist_character_add(FListAccount *, FListCharacter *);
+void flist_character_remove(FListAccount *, const gchar *name);
+/* for characters that have been added; new ones just have status set */
+void flist_character_set_status(FListAccount *, FListCharacter *, FListStatus);
+
+/* The online characters are indexed by status and gender. This fills in */
+/* the IDs of the characters with any of the genders (and, if looking is */
+/* set, that are looking). */
+void flist_characters_filter(FListAccount *, FListBitset *result, gboolean looking, guint genders);
+FListCharacter *flist_character_get_by_id(FListAccount *, guint id);
+
+/* status messages are kept as sent; the escaped form is for displaying them */
+void flist_character_set_status_message(FListAccount *, FListCharacter *, const gchar *text);
+const gchar *flist_character_get_status_message(FListCharacter *);
+const gchar *flist_character_get_status_message_escaped(FListCharacter *);
+
+void flist_characters_reserve(FListAccount *, guint count);
+void flist_characters_load(FListAccount *);
+void flist_characters_unload(FListAccount *);
+void flist_characters_stats(FListAccount *, GString *);
+
+#endif	/* FLIST_CHARACTERS_H */
@@ -31,7 +31,7 @@ void flist_update_friend(PurpleConnection *pc, const gchar *name, gboolean updat
 
     if(character) {
         purple_prpl_got_user_status(pa, name, flist_internal_status(character->status),
-                FLIST_STATUS_MESSAGE_KEY, character->status_message, NULL);
+                FLIST_STATUS_MESSAGE_KEY, flist_character_get_status_message_escaped(character), NULL);
     } else {
         purple_prpl_got_user_status(pa, name, "offline", NULL);
     }
@@ -114,8 +114,8 @@ void flist_get_tooltip(PurpleBuddy *buddy, PurpleNotifyUserInfo *user_info, gboo
     if(character) {
         purple_notify_user_info_add_pair(user_info, "Status", flist_format_status(character->status));
         purple_notify_user_info_add_pair(user_info, "Gender", flist_format_gender(character->gender));
-        if(strlen(character->status_message)) {
-            purple_notify_user_info_add_pair(user_info, "Message", character->status_message);
+        if(*flist_character_get_status_message(character)) {
+            purple_notify_user_info_add_pair(user_info, "Message", flist_character_get_status_message_escaped(character));
         }
     }
     
@@ -139,16 +139,16 @@ gchar *flist_get_status_text(PurpleBuddy *buddy) {
     if(!character) return NULL; /* user is offline, no problem here */
     
     empty_status = is_empty_status(character->status);
-    empty = empty_status && strlen(character->status_message) == 0;
+    empty = empty_status && *flist_character_get_status_message(character) == '\0';
     
     ret = g_string_new(NULL);
     g_string_append_printf(ret, "(%s)%s", flist_format_gender(character->gender), empty ? "" : " ");
     if(!empty_status) {
         g_string_append(ret, flist_format_status(character->status));
     }
-    if(strlen(character->status_message) > 0) {
+    if(*flist_character_get_status_message(character)) {
         if(!empty_status) g_string_append(ret, " - ");
-        g_string_append(ret, character->status_message);
+        g_string_append(ret, flist_character_get_status_message_escaped(character));
     }
     return g_string_free(ret, FALSE);
 }
@@ -217,15 +217,14 @@ PurpleRoomlist *flist_get_roomlist(PurpleConnection *pc) {
 guint flist_send_typing(PurpleConnection *pc, const char *name, PurpleTypingState state) {
     FListAccount *fla = pc->proto_data;
     const gchar *state_string = flist_typing_state_string(state);
-    JsonObject *json;
+    GString *frame;
 
     g_return_val_if_fail(fla, 0);
 
-    json = json_object_new();
-    json_object_set_string_member(json, "character", name);
-    json_object_set_string_member(json, "status", state_string);
-    flist_request(pc, FLIST_NOTIFY_TYPING, json);
-    json_object_unref(json);
+    frame = flist_frame_new(FLIST_NOTIFY_TYPING);
+    flist_frame_add_string(frame, "character", name);
+    flist_frame_add_string(frame, "status", state_string);
+    flist_frame_send(pc, frame);
     
     return 0; //we don't need to send again
 }
@@ -242,15 +241,13 @@ void flist_input_request_cancel_cb(gpointer user_data, const gchar *name) {
 void flist_create_private_channel_action_cb(gpointer user_data, const gchar *name) {
     PurpleConnection *pc = user_data;
     FListAccount *fla = pc->proto_data;
-    JsonObject *json;
+    GString *frame;
     
     g_return_if_fail(fla);
 
-    json = json_object_new();
-    
-    json_object_set_string_member(json, "channel", name);
-    flist_request(pc, "CCR", json);
-    json_object_unref(json);
+    frame = flist_frame_new("CCR");
+    flist_frame_add_string(frame, "channel", name);
+    flist_frame_send(pc, frame);
     
     fla->input_request = FALSE;
 }
@@ -359,7 +356,7 @@ void flist_join_channel(PurpleConnection *pc, GHashTable *components) {
     PurpleAccount *pa = purple_connection_get_account(pc);
     FListAccount *fla = pc->proto_data;
     const gchar *channel;
-    JsonObject *json;
+    GString *frame;
     PurpleConversation *convo;
     guint64 *last_ptr, last, now;
 
@@ -384,28 +381,26 @@ void flist_join_channel(PurpleConnection *pc, GHashTable *components) {
     *last_ptr = now;
     g_hash_table_replace(fla->chat_timestamp, g_strdup(channel), last_ptr);
 
-    json = json_object_new();
-    json_object_set_string_member(json, "channel", channel);
-    flist_request(pc, FLIST_CHANNEL_JOIN, json);
-    json_object_unref(json);
+    frame = flist_frame_new(FLIST_CHANNEL_JOIN);
+    flist_frame_add_string(frame, "channel", channel);
+    flist_frame_send(pc, frame);
 }
 
 void flist_leave_channel(PurpleConnection *pc, int id) {
     FListAccount *fla = pc->proto_data;
     const gchar *channel;
     PurpleConversation *convo = purple_find_chat(pc, id);
-    JsonObject *json;
+    GString *frame;
     
     g_return_if_fail(fla);
 
     if (!convo)
         return;
     
-    json = json_object_new();
+    frame = flist_frame_new(FLIST_CHANNEL_LEAVE);
     channel = purple_conversation_get_name(convo);
-    json_object_set_string_member(json, "channel", channel);
-    flist_request(pc, FLIST_CHANNEL_LEAVE, json);
-    json_object_unref(json);
+    flist_frame_add_string(frame, "channel", channel);
+    flist_frame_send(pc, frame);
 
     flist_got_channel_left(fla, channel);
     serv_got_chat_left(pc, id);
@@ -431,7 +426,7 @@ void flist_cancel_roomlist(PurpleRoomlist *list) {
 int flist_send_message(PurpleConnection *pc, const gchar *who, const gchar *message, PurpleMessageFlags flags) {
     FListAccount *fla = pc->proto_data;
     PurpleAccount *pa = purple_connection_get_account(pc);
-    JsonObject *json;
+    GString *frame;
     PurpleConvIm *im;
     gchar *stripped_message, *escaped_message, *local_message, *bbcode_message;
     int ret;
@@ -446,11 +441,10 @@ int flist_send_message(PurpleConnection *pc, const gchar *who, const gchar *mess
     local_message = purple_markup_escape_text(stripped_message, -1); /* re-escape the html entities */
     bbcode_message = flist_bbcode_to_html(fla, NULL, local_message); /* convert the bbcode to html to display locally */
 
-    json = json_object_new();
-    json_object_set_string_member(json, "recipient", who);
-    json_object_set_string_member(json, "message", escaped_message);
-    flist_request(pc, FLIST_REQUEST_PRIVATE_MESSAGE, json);
-    json_object_unref(json);
+    frame = flist_frame_new(FLIST_REQUEST_PRIVATE_MESSAGE);
+    flist_frame_add_string(frame, "recipient", who);
+    flist_frame_add_string(frame, "message", escaped_message);
+    flist_frame_send(pc, frame);
 
     im = PURPLE_CONV_IM(purple_find_conversation_with_account(PURPLE_CONV_TYPE_IM, who, pa));
     if(!im) {
@@ -496,7 +490,7 @@ static gchar *flist_fix_newlines(const char *html) {
 int flist_send_channel_message(PurpleConnection *pc, int id, const char *message, PurpleMessageFlags flags) {
     FListAccount *fla = pc->proto_data;
     PurpleConversation *convo = purple_find_chat(pc, id);
-    JsonObject *json = json_object_new();
+    GString *frame;
     const gchar *channel;
     gchar *stripped_message, *escaped_message, *local_message, *bbcode_message;
 
@@ -515,9 +509,10 @@ int flist_send_channel_message(PurpleConnection *pc, int id, const char *message
     local_message = purple_markup_escape_text(stripped_message, -1); /* re-escape the html entities */
     bbcode_message = flist_bbcode_to_html(fla, convo, local_message); /* convert the bbcode to html to display locally */
     channel = purple_conversation_get_name(convo);
-    json_object_set_string_member(json, "message", escaped_message);
-    json_object_set_string_member(json, "channel", channel);
-    flist_request(pc, FLIST_REQUEST_CHANNEL_MESSAGE, json);
+    frame = flist_frame_new(FLIST_REQUEST_CHANNEL_MESSAGE);
+    flist_frame_add_string(frame, "message", escaped_message);
+    flist_frame_add_string(frame, "channel", channel);
+    flist_frame_send(pc, frame);
 
     purple_debug(PURPLE_DEBUG_INFO, "flist", "Writing: %s\n", bbcode_message);
     serv_got_chat_in(pc, id, fla->proper_character, flags, bbcode_message, time(NULL));
@@ -533,12 +528,11 @@ int flist_send_channel_message(PurpleConnection *pc, int id, const char *message
 
 PurpleCmdRet flist_roll_dice(PurpleConversation *convo, const gchar *cmd, gchar **args, gchar **error, void *data) {
     PurpleConnection *pc = purple_conversation_get_gc(convo);
-    JsonObject *json = json_object_new();
+    GString *frame = flist_frame_new(FLIST_ROLL_DICE);
     const gchar *channel = purple_conversation_get_name(convo);
-    json_object_set_string_member(json, "channel", channel);
-    json_object_set_string_member(json, "dice", args[0]); //TODO: check for proper dice format: xdy
-    flist_request(pc, FLIST_ROLL_DICE, json);
-    json_object_unref(json);
+    flist_frame_add_string(frame, "channel", channel);
+    flist_frame_add_string(frame, "dice", args[0]); //TODO: check for proper dice format: xdy
+    flist_frame_send(pc, frame);
     return PURPLE_CMD_STATUS_OK;
 }
 
@@ -593,7 +587,7 @@ PurpleCmdRet flist_channel_hide_chat_cmd(PurpleConversation *convo, const gchar
 PurpleCmdRet flist_channel_send_ad(PurpleConversation *convo, const gchar *cmd, gchar **args, gchar **error, void *data) {
     PurpleConnection *pc = purple_conversation_get_gc(convo);
     FListAccount *fla = pc->proto_data;
-    JsonObject *json;
+    GString *frame;
     const gchar *channel = purple_conversation_get_name(convo);
     const gchar *message = args[0];
     gchar *e1, *e2, *e3, *local_message, *full_message, *bbcode_message;
@@ -609,11 +603,10 @@ PurpleCmdRet flist_channel_send_ad(PurpleConversation *convo, const gchar *cmd,
     full_message = g_strdup_printf("[b](Roleplay Ad)[/b] %s", local_message);
     bbcode_message = flist_bbcode_to_html(fla, NULL, full_message); /* convert the bbcode to html to display locally */
 
-    json = json_object_new();
-    json_object_set_string_member(json, "channel", channel);
-    json_object_set_string_member(json, "message", e3);
-    flist_request(pc, FLIST_CHANNEL_ADVERSTISEMENT, json);
-    json_object_unref(json);
+    frame = flist_frame_new(FLIST_CHANNEL_ADVERSTISEMENT);
+    flist_frame_add_string(frame, "channel", channel);
+    flist_frame_add_string(frame, "message", e3);
+    flist_frame_send(pc, frame);
 
     purple_debug(PURPLE_DEBUG_INFO, "flist", "Writing: %s\n", bbcode_message);
     serv_got_chat_in(pc, PURPLE_CONV_CHAT(convo)->id, fla->proper_character, 
@@ -678,6 +671,24 @@ PurpleCmdRet flist_whoami_cmd(PurpleConversation *convo, const gchar *cmd, gchar
     return PURPLE_CMD_STATUS_OK;
 }
 
+PurpleCmdRet flist_debugstats_cmd(PurpleConversation *convo, const gchar *cmd, gchar **args, gchar **error, void *data) {
+    PurpleConnection *pc = purple_conversation_get_gc(convo);
+    FListAccount *fla = pc->proto_data;
+    GString *str = g_string_new(NULL);
+    gchar *to_print;
+    
+    flist_connection_stats(fla, str);
+    flist_callback_stats(fla, str);
+    flist_characters_stats(fla, str);
+    flist_channel_stats(fla, str);
+    
+    to_print = g_string_free(str, FALSE);
+    purple_conversation_write(convo, NULL, to_print, PURPLE_MESSAGE_SYSTEM, time(NULL));
+    g_free(to_print);
+    
+    return PURPLE_CMD_STATUS_OK;
+}
+
 void flist_init_commands() {
     PurpleCmdFlag channel_flags = PURPLE_CMD_FLAG_PRPL_ONLY | PURPLE_CMD_FLAG_CHAT;
     PurpleCmdFlag anywhere_flags = PURPLE_CMD_FLAG_PRPL_ONLY | PURPLE_CMD_FLAG_CHAT | PURPLE_CMD_FLAG_IM;
@@ -691,6 +702,9 @@ void flist_init_commands() {
     purple_cmd_register("whoami", "", PURPLE_CMD_P_PRPL, anywhere_flags,
         FLIST_PLUGIN_ID, flist_whoami_cmd, "whoami: Displays which character you are using.", NULL);
     
+    purple_cmd_register("debugstats", "", PURPLE_CMD_P_PRPL, anywhere_flags,
+        FLIST_PLUGIN_ID, flist_debugstats_cmd, "debugstats: Displays connection and performance counters.", NULL);
+    
     purple_cmd_register("open", "", PURPLE_CMD_P_PRPL, channel_flags,
         FLIST_PLUGIN_ID, flist_channel_open_cmd, "open: Opens the current private channel.", NULL);
     purple_cmd_register("openroom", "", PURPLE_CMD_P_PRPL, channel_flags,
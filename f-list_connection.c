@@ -22,6 +22,8 @@
 
 /* disconnect after 90 seconds without a ping response */
 #define FLIST_TIMEOUT 90
+/* the most frames we hand to a single writev() */
+#define FLIST_MAX_IOV 64
 /* how often we request a new ticket for the API */
 #define FLIST_TICKET_TIMER_TIMEOUT 600
 
@@ -50,17 +52,148 @@ void flist_receive_ping(PurpleConnection *pc) {
     fla->ping_timeout_handle = purple_timeout_add_seconds(FLIST_TIMEOUT, flist_disconnect_cb, pc);
 }
 
+/* Writes out as much of the send queue as the socket will take. Returns */
+/* FALSE if the connection failed. */
+static gboolean flist_flush(PurpleConnection *pc) {
+    FListAccount *fla = pc->proto_data;
+    gssize len;
+
+    while(flist_tx_queue_length(fla->tx_queue) > 0) {
+        guint depth = flist_tx_queue_depth(fla->tx_queue);
+#ifndef _WIN32
+        struct iovec iov[FLIST_MAX_IOV];
+        int count = flist_tx_queue_get_iov(fla->tx_queue, iov, FLIST_MAX_IOV);
+        len = writev(fla->fd, iov, count);
+#else
+        gsize to_write_len;
+        const gchar *to_write = flist_tx_queue_peek(fla->tx_queue, &to_write_len);
+        len = write(fla->fd, to_write, to_write_len);
+#endif
+        if(len < 0) {
+            gchar *error;
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break; //wait until the socket is writable
+            error = g_strdup_printf(_("Lost connection with server: %s"), g_strerror(errno));
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, error);
+            g_free(error);
+            return FALSE;
+        }
+        flist_tx_queue_advance(fla->tx_queue, (gsize) len);
+        fla->stat_writes++;
+        fla->stat_bytes_out += (guint64) len;
+        fla->stat_frames_out += depth - flist_tx_queue_depth(fla->tx_queue);
+    }
+    return TRUE;
+}
+
+static void flist_send_cb(gpointer data, gint source, PurpleInputCondition cond) {
+    PurpleConnection *pc = data;
+    FListAccount *fla = pc->proto_data;
+
+    if(!flist_flush(pc) || flist_tx_queue_length(fla->tx_queue) == 0) {
+        purple_input_remove(fla->output_handle);
+        fla->output_handle = 0;
+    }
+}
+
+/* Frames are never written right away. Instead, we wait for the socket to */
+/* become writable, so everything we send during one pass of the main loop */
+/* goes out together in a single writev(). */
+void flist_send_raw(FListAccount *fla, GString *data, gsize offset) {
+    flist_tx_queue_push(fla->tx_queue, data, offset);
+    if(flist_tx_queue_depth(fla->tx_queue) > fla->stat_max_queue_depth) {
+        fla->stat_max_queue_depth = flist_tx_queue_depth(fla->tx_queue);
+    }
+    if(!fla->output_handle && fla->fd > 0) {
+        fla->output_handle = purple_input_add(fla->fd, PURPLE_INPUT_WRITE, flist_send_cb, fla->pc);
+    }
+}
+
+/* Outgoing messages start with room for the transport's frame header, so */
+/* it can be written in place once we know how long the message is. */
+static GString *flist_message_new(const gchar *code) {
+    GString *message = g_string_sized_new(128);
+    g_string_set_size(message, FLIST_WEBSOCKET_HEADROOM);
+    g_string_append(message, code);
+    return message;
+}
+
+static void flist_message_send(FListAccount *fla, GString *message) {
+    if(fla->websocket) {
+        flist_send_raw(fla, message, flist_websocket_wrap(message, FLIST_WEBSOCKET_HEADROOM));
+    } else {
+        message->str[FLIST_WEBSOCKET_HEADROOM - 1] = '\x00';
+        g_string_append_c(message, '\xFF');
+        flist_send_raw(fla, message, FLIST_WEBSOCKET_HEADROOM - 1);
+    }
+}
+
+/* A frame is built as "CODE {" and members are appended straight into */
+/* it, so simple commands don't need a JsonObject or a JsonGenerator. */
+GString *flist_frame_new(const gchar *code) {
+    GString *frame = flist_message_new(code);
+    g_string_append(frame, " {");
+    return frame;
+}
+
+static void flist_frame_append_escaped(GString *frame, const gchar *value) {
+    gboolean valid = g_utf8_validate(value, -1, NULL);
+    const gchar *run = value, *cur;
+
+    g_string_append_c(frame, '"');
+    for(cur = value; *cur; cur++) {
+        guchar c = (guchar) *cur;
+        if(c >= 0x20 && c != '"' && c != '\\' && (valid || c < 0x80)) continue;
+        g_string_append_len(frame, run, (gssize) (cur - run));
+        run = cur + 1;
+        switch(c) {
+            case '"': g_string_append(frame, "\\\""); break;
+            case '\\': g_string_append(frame, "\\\\"); break;
+            case '\n': g_string_append(frame, "\\n"); break;
+            case '\r': g_string_append(frame, "\\r"); break;
+            case '\t': g_string_append(frame, "\\t"); break;
+            /* control characters, and bytes that aren't UTF-8 (read as Latin-1) */
+            default: g_string_append_printf(frame, "\\u%04x", c);
+        }
+    }
+    g_string_append_len(frame, run, (gssize) (cur - run));
+    g_string_append_c(frame, '"');
+}
+
+static void flist_frame_append_key(GString *frame, const gchar *key) {
+    if(frame->str[frame->len - 1] != '{') g_string_append_c(frame, ',');
+    flist_frame_append_escaped(frame, key);
+    g_string_append_c(frame, ':');
+}
+
+void flist_frame_add_string(GString *frame, const gchar *key, const gchar *value) {
+    g_return_if_fail(value != NULL);
+    flist_frame_append_key(frame, key);
+    flist_frame_append_escaped(frame, value);
+}
+
+void flist_frame_add_int(GString *frame, const gchar *key, gint value) {
+    flist_frame_append_key(frame, key);
+    g_string_append_printf(frame, "%d", value);
+}
+
+void flist_frame_send(PurpleConnection *pc, GString *frame) {
+    FListAccount *fla = pc->proto_data;
+
+    if(frame->str[frame->len - 1] == '{') { /* no members, so we send the bare code */
+        g_string_truncate(frame, frame->len - 2);
+    } else {
+        g_string_append_c(frame, '}');
+    }
+
+    flist_message_send(fla, frame);
+}
+
 void flist_request(PurpleConnection *pc, const gchar* type, JsonObject *object) {
     FListAccount *fla = pc->proto_data;
     gsize json_len;
     gchar *json_text = NULL;
-    gsize sent;
-    GString *to_write_str = g_string_new(NULL);
-    gchar *to_write;
-    gsize to_write_len;
-    
-    g_string_append_c(to_write_str, '\x00');
-    g_string_append(to_write_str, type);
+    GString *to_write_str = flist_message_new(type);
     
     if(object) {
         JsonNode *root = json_node_new(JSON_NODE_OBJECT);
@@ -75,75 +208,96 @@ void flist_request(PurpleConnection *pc, const gchar* type, JsonObject *object)
         json_node_free(root);
     }
     
-    g_string_append_c(to_write_str, '\xFF');
-    
-    to_write_len = to_write_str->len;
-    to_write = g_string_free(to_write_str, FALSE);
-    // TODO: check the return value of write()
-    sent = write(fla->fd, to_write, to_write_len);
-    g_free(to_write);
+    flist_message_send(fla, to_write_str);
+}
+
+/* A capture is a series of records, one for each recv(): a header line */
+/* "seconds.microseconds length", followed by exactly that many raw bytes. */
+/* It holds the handshake too, so it can be fed through flist_process again. */
+void flist_capture_open(FListAccount *fla, const gchar *path) {
+    if(!path || !*path) return;
+    fla->capture = fopen(path, "ab");
+    if(!fla->capture) {
+        purple_debug_warning(FLIST_DEBUG, "Could not open capture file %s: %s\n", path, g_strerror(errno));
+    }
+}
+
+static void flist_capture_write(FListAccount *fla, const gchar *data, gsize len) {
+    GTimeVal now;
+
+    g_get_current_time(&now);
+    fprintf(fla->capture, "%ld.%06ld %" G_GSIZE_FORMAT "\n", (long) now.tv_sec, (long) now.tv_usec, len);
+    fwrite(data, 1, len, fla->capture);
 }
 
+/* Reads everything the socket has for us, up to the receive budget. We stop */
+/* early so that a large login burst can't starve the rest of the UI; the */
+/* input watch fires again right away if there is more data left. */
 static gboolean flist_recv(PurpleConnection *pc, gint source, PurpleInputCondition cond) {
     FListAccount *fla = pc->proto_data;
-    gchar buf[4096];
+    gchar *buf;
+    gsize available;
+    gsize total = 0;
     gssize len;
-        
-    len = recv(fla->fd, buf, sizeof(buf) - 1, 0);
-    if(len <= 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return FALSE; //try again later
-        //TODO: better error reporting
-        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "The connection has failed.");
-        return FALSE;
+
+    while(total < fla->recv_budget) {
+        buf = flist_rx_buffer_reserve(fla->rx_buf, &available);
+        len = recv(fla->fd, buf, MIN(available, fla->recv_budget - total), 0);
+        if(len == 0) {
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "The server closed the connection.");
+            return FALSE;
+        }
+        if(len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) break; //try again later
+            //TODO: better error reporting
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "The connection has failed.");
+            return FALSE;
+        }
+        flist_rx_buffer_commit(fla->rx_buf, (gsize) len);
+        if(fla->capture) flist_capture_write(fla, buf, (gsize) len);
+        total += (gsize) len;
     }
-    buf[len] = '\0';
-    fla->rx_buf = g_realloc(fla->rx_buf, fla->rx_len + len + 1);
-    memcpy(fla->rx_buf + fla->rx_len, buf, len + 1);
-    fla->rx_len += len;
-    return TRUE;
+
+    fla->stat_bytes_in += total;
+    return total > 0;
 }
 
-static gboolean flist_handle_input(PurpleConnection *pc) {
+/* Handles one message, "CODE {json}" or just "CODE", whatever the framing. */
+/* The data is not terminated, and only has to stay valid during the call. */
+gboolean flist_handle_message(PurpleConnection *pc, const gchar *data, gsize len) {
     FListAccount *fla = pc->proto_data;
-    gchar *start, *end; gchar *rx_buf_end;
-    JsonParser *parser = NULL;
+    const gchar *start = data, *end = data + len;
+    gsize code_len;
     JsonNode *root = NULL;
     JsonObject *object = NULL;
     GError *err = NULL;
     gboolean ret = FALSE;
-    gchar *code;
+    gchar code[4];
 
-    g_return_val_if_fail(fla, FALSE);
-
-    if(fla->rx_len == 0) return FALSE; //nothing to read here!
-    
-    if(fla->rx_buf[0] != '\x00') {
-        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (not a WebSocket frame).");
-    }
-    rx_buf_end = fla->rx_buf + fla->rx_len;
-    start = fla->rx_buf + 1;
-    end = fla->rx_buf;
-    while(end < rx_buf_end && *end != '\xff') end++;
-    if(end == rx_buf_end) return FALSE; //we don't have a full packet yet
-    code = g_strndup(start, 3);
-    start += 3;
+    code_len = MIN(3, len);
+    memcpy(code, start, code_len);
+    code[code_len] = '\0';
+    start += code_len;
     if(start < end && strcmp(code, "WSH")) {
         start++;
-        parser = json_parser_new();
-        json_parser_load_from_data(parser, start, (gsize) (end - start), &err);
         
         if(fla->debug_mode) {
-            gchar *full_packet = g_strndup(start, (gsize) (end - start));
-            purple_debug_info(FLIST_DEBUG, "JSON Received: %s\n", full_packet);
-            g_free(full_packet);
+            purple_debug_info(FLIST_DEBUG, "JSON Received: %.*s\n", (int) (end - start), start);
+        }
+        
+        if(flist_callback_fast(pc, code, start, (gsize) (end - start))) {
+            purple_debug_info("flist", "Received Packet. Code: %s\n", code);
+            ret = TRUE;
+            goto cleanup;
         }
         
+        json_parser_load_from_data(fla->json_parser, start, (gssize) (end - start), &err);
         if(err) { /* not valid json */
             purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (expecting JSON).");
             g_error_free(err);
             goto cleanup;
         }
-        root = json_parser_get_root(parser);
+        root = json_parser_get_root(fla->json_parser);
         if(json_node_get_node_type(root) != JSON_NODE_OBJECT) {
             purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (JSON not an object).");
             goto cleanup;
@@ -157,64 +311,128 @@ static gboolean flist_handle_input(PurpleConnection *pc) {
     
     cleanup:
     
-    end++;
-    fla->rx_len = (gsize) (fla->rx_buf + fla->rx_len - end);
-    memmove(fla->rx_buf, end, fla->rx_len + 1);
-    
-    g_free(code);
-    if(parser) g_object_unref(parser);
+    flist_arena_reset(fla->frame_arena);
     
     return ret;
 }
 
-static gboolean flist_handle_handshake(PurpleConnection *pc) {
+static gboolean flist_handle_input(PurpleConnection *pc) {
     FListAccount *fla = pc->proto_data;
-    gchar *last = fla->rx_buf;
-    gchar *read = strstr(last, "\r\n");
+    const gchar *frame;
+    gsize frame_len;
+    gboolean ret;
+
+    g_return_val_if_fail(fla, FALSE);
+
+    if(flist_rx_buffer_length(fla->rx_buf) == 0) return FALSE; //nothing to read here!
     
-    while(read != NULL && read > last) {
-        last = read + 2;
-        read = strstr(last, "\r\n");
+    if(*flist_rx_buffer_peek(fla->rx_buf, 1) != '\x00') {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (not a WebSocket frame).");
     }
+    if(!flist_rx_buffer_find(fla->rx_buf, '\xff', &frame_len)) return FALSE; //we don't have a full packet yet
+    frame_len++; /* include the terminator */
+    
+    /* the frame stays in place until we consume it below */
+    frame = flist_rx_buffer_peek(fla->rx_buf, frame_len);
+    ret = flist_handle_message(pc, frame + 1, frame_len - 2);
+    flist_rx_buffer_consume(fla->rx_buf, frame_len);
+    
+    return ret;
+}
+
+static gboolean flist_handle_handshake(PurpleConnection *pc) {
+    FListAccount *fla = pc->proto_data;
+    gsize len = flist_rx_buffer_length(fla->rx_buf);
+    const gchar *headers = flist_rx_buffer_peek(fla->rx_buf, len);
+    const gchar *read = g_strstr_len(headers, len, "\r\n\r\n");
+    gsize header_len;
     
     if(read == NULL) return FALSE;
 
-    read += 2; //last line
-    read += 16; //useless token
-    if(read >= fla->rx_buf + fla->rx_len) { //make sure we didn't overflow
-        fla->rx_len -= (gsize) (read - fla->rx_buf);
-        memmove(fla->rx_buf, read, fla->rx_len + 1);
-        flist_IDN(pc);
-        fla->connection_status = FLIST_IDENTIFY;
-        return TRUE;
-    } else return FALSE;
+    header_len = (gsize) (read - headers);
+    header_len += 4; //last line
+    header_len += 16; //useless token
+    if(header_len > len) return FALSE; //we don't have the token yet
+    
+    flist_rx_buffer_consume(fla->rx_buf, header_len);
+    flist_IDN(pc);
+    fla->connection_status = FLIST_IDENTIFY;
+    return TRUE;
 }
 
 void flist_process(gpointer data, gint source, PurpleInputCondition cond) {
     PurpleConnection *pc = data;
     FListAccount *fla = pc->proto_data;
+    guint frames = 0;
+    gint64 start;
     
     if(!flist_recv(pc, source, cond)) return;
-    if(fla->connection_status == FLIST_HANDSHAKE && !flist_handle_handshake(pc)) return;
-    while(flist_handle_input(pc));
+    fla->stat_wakeups++;
+    start = g_get_monotonic_time();
+    if(fla->websocket) {
+        if(fla->connection_status == FLIST_HANDSHAKE && !flist_websocket_handle_handshake(pc)) return;
+        while(flist_websocket_handle_input(pc)) frames++;
+    } else {
+        if(fla->connection_status == FLIST_HANDSHAKE && !flist_handle_handshake(pc)) return;
+        while(flist_handle_input(pc)) frames++;
+    }
+    
+    fla->stat_process_usec += (guint64) (g_get_monotonic_time() - start);
+    fla->stat_frames_in += frames;
+    fla->stat_last_frames = frames;
+    if(frames > fla->stat_max_frames) fla->stat_max_frames = frames;
+    if(fla->debug_mode) {
+        purple_debug_info(FLIST_DEBUG, "Handled %u frames (%" G_GSIZE_FORMAT " bytes left unparsed).\n",
+            frames, flist_rx_buffer_length(fla->rx_buf));
+    }
+}
+
+void flist_connection_stats(FListAccount *fla, GString *str) {
+#ifndef _WIN32
+    struct rusage usage;
+#endif
+
+    g_string_append_printf(str, "Input events: %" G_GUINT64_FORMAT ", bytes received: %" G_GUINT64_FORMAT "<br>",
+        fla->stat_wakeups, fla->stat_bytes_in);
+    g_string_append_printf(str, "Frames received: %" G_GUINT64_FORMAT " (last event: %u, most in one event: %u)<br>",
+        fla->stat_frames_in, fla->stat_last_frames, fla->stat_max_frames);
+    if(fla->stat_process_usec > 0) {
+        gdouble seconds = (gdouble) fla->stat_process_usec / G_USEC_PER_SEC;
+        g_string_append_printf(str, "Time spent handling frames: %.3f s (%.0f frames/s, %.1f MiB/s)<br>",
+            seconds, fla->stat_frames_in / seconds, fla->stat_bytes_in / seconds / (1024 * 1024));
+    }
+#ifndef _WIN32
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+        /* this is for the whole process, so it includes the rest of the client */
+        g_string_append_printf(str, "Peak resident memory: %ld KiB<br>", (long) usage.ru_maxrss);
+    }
+#endif
+    g_string_append_printf(str, "Writes: %" G_GUINT64_FORMAT ", frames sent: %" G_GUINT64_FORMAT ", bytes sent: %" G_GUINT64_FORMAT "<br>",
+        fla->stat_writes, fla->stat_frames_out, fla->stat_bytes_out);
+    g_string_append_printf(str, "Send queue: %u frames, %" G_GSIZE_FORMAT " bytes (most queued: %u)<br>",
+        flist_tx_queue_depth(fla->tx_queue), flist_tx_queue_length(fla->tx_queue), fla->stat_max_queue_depth);
+    if(fla->websocket) flist_websocket_stats(fla->websocket, str);
+    g_string_append_printf(str, "Decoded without a JSON tree: %" G_GUINT64_FORMAT " frames (%" G_GUINT64_FORMAT " fell back)<br>",
+        fla->stat_fast_hits, fla->stat_fast_misses);
+    g_string_append_printf(str, "Frame arena: %" G_GUINT64_FORMAT " allocations, %" G_GUINT64_FORMAT " from the heap<br>",
+        flist_arena_allocs(fla->frame_arena), flist_arena_block_allocs(fla->frame_arena));
 }
 
 void flist_IDN(PurpleConnection *pc) {
     FListAccount *fla = pc->proto_data;
-    JsonObject *object;
+    GString *frame;
     const gchar *ticket = flist_get_ticket(fla);
     
-    object = json_object_new();
+    frame = flist_frame_new("IDN");
     if(ticket) {
-        json_object_set_string_member(object, "method", "ticket");
-        json_object_set_string_member(object, "ticket", ticket);
-        json_object_set_string_member(object, "account", fla->username);
-        json_object_set_string_member(object, "cname", FLIST_CLIENT_NAME);
-        json_object_set_string_member(object, "cversion", FLIST_PLUGIN_VERSION);
+        flist_frame_add_string(frame, "method", "ticket");
+        flist_frame_add_string(frame, "ticket", ticket);
+        flist_frame_add_string(frame, "account", fla->username);
+        flist_frame_add_string(frame, "cname", FLIST_CLIENT_NAME);
+        flist_frame_add_string(frame, "cversion", FLIST_PLUGIN_VERSION);
     }
-    json_object_set_string_member(object, "character", fla->character);
-    flist_request(pc, "IDN", object);
-    json_object_unref(object);
+    flist_frame_add_string(frame, "character", fla->character);
+    flist_frame_send(pc, frame);
 }
 
 void flist_connected(gpointer user_data, int fd, const gchar *err) {
@@ -230,10 +448,12 @@ void flist_connected(gpointer user_data, int fd, const gchar *err) {
 
     fla->input_handle = purple_input_add(fla->fd, PURPLE_INPUT_READ, flist_process, fla->pc);
     fla->ping_timeout_handle = purple_timeout_add_seconds(FLIST_TIMEOUT, flist_disconnect_cb, fla->pc);
-    if(fla->use_websocket_handshake) {
+    if(fla->use_rfc6455) {
+        fla->websocket = flist_websocket_new(fla->websocket_compression);
+        flist_send_raw(fla, flist_websocket_handshake(fla->websocket, fla->server_address, fla->server_port), 0);
+        fla->connection_status = FLIST_HANDSHAKE;
+    } else if(fla->use_websocket_handshake) {
         GString *headers_str = g_string_new(NULL);
-        gchar *headers;
-        int len;
         //TODO: insert proper randomness here!
         g_string_append(headers_str, "GET / HTTP/1.1\r\n");
         g_string_append(headers_str, "Upgrade: WebSocket\r\n");
@@ -245,11 +465,9 @@ void flist_connected(gpointer user_data, int fd, const gchar *err) {
         g_string_append(headers_str, "Sec-WebSocket-Key2: 3qJ1  16=8v97(98:8Mah\r\n");
         g_string_append(headers_str, "\r\n");
         g_string_append(headers_str, "d.;~w.A."); //TODO: throw in randomness!
-        headers = g_string_free(headers_str, FALSE);
 
-        len = write(fla->fd, headers, strlen(headers)); //TODO: check return value
+        flist_send_raw(fla, headers_str, 0);
         fla->connection_status = FLIST_HANDSHAKE;
-        g_free(headers);
     } else {
         flist_request(fla->pc, "WSH", NULL);
         fla->connection_status = FLIST_IDENTIFY;
@@ -296,13 +514,12 @@ static void flist_receive_ticket(FListWebRequestData *req_data, gpointer data, J
 
 static gboolean flist_ticket_timer_cb(gpointer data) {
     FListAccount *fla = data;
-    const gchar *url_pattern = "http://www.f-list.net/json/getApiTicket.php";
     GHashTable *args = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
     g_hash_table_insert(args, "account", g_strdup(fla->username));
     g_hash_table_insert(args, "password", g_strdup(fla->password));
     g_hash_table_insert(args, "secure", g_strdup("no"));
     
-    fla->ticket_request = flist_web_request(url_pattern, args, TRUE, flist_receive_ticket, fla); 
+    fla->ticket_request = flist_web_request(fla->ticket_url, args, TRUE, flist_receive_ticket, fla); 
     fla->ticket_timer = 0;
     
     g_hash_table_destroy(args);
@@ -23,11 +23,28 @@
 
 #include "f-list.h"
 
+/* default number of KiB read per input event, see the recv_budget option */
+#define FLIST_RECV_BUDGET 256
+/* can be pointed somewhere else for testing */
+#define FLIST_TICKET_URL "http://www.f-list.net/json/getApiTicket.php"
+
 const gchar *flist_get_ticket(FListAccount *);
 void flist_request(PurpleConnection *, const gchar *, JsonObject *);
+void flist_send_raw(FListAccount *, GString *data, gsize offset);
+gboolean flist_handle_message(PurpleConnection *, const gchar *data, gsize len);
+
+/* lightweight frames for simple commands; flist_frame_send takes ownership */
+GString *flist_frame_new(const gchar *code);
+void flist_frame_add_string(GString *frame, const gchar *key, const gchar *value);
+void flist_frame_add_int(GString *frame, const gchar *key, gint value);
+void flist_frame_send(PurpleConnection *, GString *frame);
 void flist_IDN(PurpleConnection *);
+void flist_connected(gpointer user_data, int fd, const gchar *err);
 void flist_process(gpointer data, gint source, PurpleInputCondition cond);
 
+void flist_connection_stats(FListAccount *, GString *);
+void flist_capture_open(FListAccount *, const gchar *path);
+
 void flist_receive_ping(PurpleConnection *);
 void flist_ticket_timer(FListAccount *, guint);
 
@@ -52,7 +52,7 @@ struct FListFriends_ {
 };
 
 typedef struct FListFriend_ {
-    gchar *name;
+    const gchar *name; /* owned by FListAccount.names */
     FListFriendStatus status;
     gint code;
     gboolean bookmarked;
@@ -73,14 +73,16 @@ struct FListFriendsRequest_ {
 };
 
 static void flist_friend_free(gpointer data) {
-    FListFriend *f = data;
-    g_free(f->name);
-    g_free(f);
+    g_free(data);
 }
 
 static inline FListFriends *_flist_friends(FListAccount *fla) {
     return fla->flist_friends;
 }
+
+static FListFriend *flist_friend_find(FListAccount *fla, const gchar *character) {
+    return g_hash_table_lookup(_flist_friends(fla)->friends, GUINT_TO_POINTER(flist_name_id(fla->names, character)));
+}
 static void flist_friends_sync_timer(FListAccount *fla, guint32 timeout);
 
 static void flist_friends_request_delete(FListFriendsRequest *req) {
@@ -130,10 +132,9 @@ static void _clear_updates(FListFriends *flf) {
 }
 
 gboolean flist_friends_is_bookmarked(FListAccount* fla, const gchar* character) {
-    FListFriends *flf = _flist_friends(fla);
     FListFriend *friend;
     
-    friend = g_hash_table_lookup(flf->friends, character);
+    friend = flist_friend_find(fla, character);
     if(!friend) return FALSE;
     return friend->bookmarked;
 }
@@ -142,7 +143,7 @@ FListFriendStatus flist_friends_get_friend_status(FListAccount* fla, const gchar
     FListFriend *friend;
     if(!flf->friends) return FLIST_FRIEND_STATUS_UNKNOWN;
     
-    friend = g_hash_table_lookup(flf->friends, character);
+    friend = flist_friend_find(fla, character);
     if(!friend) return FLIST_NOT_FRIEND;
     return friend->status;
 }
@@ -177,8 +178,10 @@ static void flist_friends_action_cb(FListWebRequestData* req_data, gpointer user
     }
     
     if(!success && req->type == FLIST_BOOKMARK_ADD) {
-        gchar *character = g_strdup(req->character);
-        g_hash_table_insert(flf->cannot_bookmark, character, character);
+        /* this may be what the user typed, which mustn't become a name; */
+        /* one we've never seen is just refused again if it is retried */
+        gpointer id = GUINT_TO_POINTER(flist_name_id(fla->names, req->character));
+        if(id) g_hash_table_insert(flf->cannot_bookmark, id, id);
     }
     
     if(!success && primary_error && secondary_error) {
@@ -200,7 +203,7 @@ static void flist_friends_action_cb(FListWebRequestData* req_data, gpointer user
 gboolean flist_friend_action(FListAccount *fla, const gchar *name, FListFriendsRequestType type, gboolean automatic) {
     FListFriends *flf = _flist_friends(fla);
     GHashTable *args = flist_web_request_args(fla);
-    FListFriend *friend = g_hash_table_lookup(flf->friends, name);
+    FListFriend *friend = flist_friend_find(fla, name);
     FListFriendsRequest *req = g_new0(FListFriendsRequest, 1);
 
     req->fla = fla;
@@ -244,7 +247,7 @@ gboolean flist_friend_action(FListAccount *fla, const gchar *name, FListFriendsR
         flf->outgoing_requests_dirty = TRUE;
         break;
     case FLIST_BOOKMARK_ADD:
-        if(g_hash_table_lookup(flf->cannot_bookmark, name)) break; /* We cannot bookmark some users. Move on. */
+        if(g_hash_table_lookup(flf->cannot_bookmark, GUINT_TO_POINTER(flist_name_id(fla->names, name)))) break; /* We cannot bookmark some users. Move on. */
         g_hash_table_insert(args, "name", g_strdup(name));
         req->req_data = flist_web_request(JSON_BOOKMARK_ADD, args, TRUE, flist_friends_action_cb, req);
         flf->bookmarks_dirty = TRUE;
@@ -312,7 +315,7 @@ static void flist_auth_accept_cb(gpointer user_data) {
     FListFriend *friend;
     
     flf->auth_requests = g_list_remove(flf->auth_requests, auth);
-    friend = g_hash_table_lookup(flf->friends, auth->name);
+    friend = flist_friend_find(fla, auth->name);
     
     if(friend) {
         flist_friend_action(fla, auth->name, FLIST_FRIEND_AUTHORIZE, FALSE);
@@ -329,7 +332,7 @@ static void flist_auth_deny_cb(gpointer user_data) {
     FListFriend *friend;
     
     flf->auth_requests = g_list_remove(flf->auth_requests, auth);
-    friend = g_hash_table_lookup(flf->friends, auth->name);
+    friend = flist_friend_find(fla, auth->name);
     
     if(friend) {
         flist_friend_action(fla, auth->name, FLIST_FRIEND_DENY, FALSE);
@@ -413,12 +416,13 @@ static void flist_friends_reset_bookmarks(GHashTable *friends) {
         friend->bookmarked = FALSE;
     }
 }
-static FListFriend* flist_friend_get(GHashTable *friends, const gchar *character) {
-    FListFriend *friend = g_hash_table_lookup(friends, character);
+static FListFriend* flist_friend_get(FListAccount *fla, const gchar *character) {
+    guint id = flist_name_intern(fla->names, character);
+    FListFriend *friend = g_hash_table_lookup(_flist_friends(fla)->friends, GUINT_TO_POINTER(id));
     if(!friend) {
         friend = g_new0(FListFriend, 1);
-        friend->name = g_strdup(character);
-        g_hash_table_replace(friends, friend->name, friend);
+        friend->name = flist_name_get(fla->names, id);
+        g_hash_table_replace(_flist_friends(fla)->friends, GUINT_TO_POINTER(id), friend);
         friend->status = FLIST_NOT_FRIEND;
         friend->bookmarked = FALSE;
     }
@@ -443,7 +447,7 @@ static void flist_handle_friends_list(FListAccount *fla, JsonArray *array, FList
         //We are only interested in friends of the current character.
         if(flist_strcmp(fla->character, source)) continue;
         
-        friend = flist_friend_get(flf->friends, dest);
+        friend = flist_friend_get(fla, dest);
         friend->status = status;
         friend->code = id;
     }
@@ -458,7 +462,7 @@ static void flist_handle_bookmark_list(FListAccount *fla, JsonArray *array) {
     len = json_array_get_length(array);
     for(index = 0; index < len; index++) {
         const gchar *character = json_array_get_string_element(array, index);
-        FListFriend *friend = flist_friend_get(flf->friends, character);
+        FListFriend *friend = flist_friend_get(fla, character);
         friend->bookmarked = TRUE;
     }
 }
@@ -571,6 +575,19 @@ void flist_friends_login(FListAccount *fla) {
     flist_friends_sync_timer(fla, 0);
 }
 
+/* for flist_names_collect: friends and bookmarks keep their names */
+void flist_friends_mark_names(FListAccount *fla, FListBitset *keep) {
+    FListFriends *flf = _flist_friends(fla);
+    GHashTableIter iter;
+    gpointer id;
+
+    if(!flf) return;
+    g_hash_table_iter_init(&iter, flf->friends);
+    while(g_hash_table_iter_next(&iter, &id, NULL)) flist_bitset_add(keep, GPOINTER_TO_UINT(id));
+    g_hash_table_iter_init(&iter, flf->cannot_bookmark);
+    while(g_hash_table_iter_next(&iter, &id, NULL)) flist_bitset_add(keep, GPOINTER_TO_UINT(id));
+}
+
 void flist_friends_load(FListAccount *fla) {
     FListFriends *flf;
     fla->flist_friends = g_new0(FListFriends, 1);
@@ -581,8 +598,8 @@ void flist_friends_load(FListAccount *fla) {
     flf->incoming_requests_dirty = TRUE;
     flf->outgoing_requests_dirty = TRUE;
     
-    flf->friends = g_hash_table_new_full((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal, NULL, flist_friend_free);
-    flf->cannot_bookmark = g_hash_table_new_full((GHashFunc) flist_str_hash, (GEqualFunc) flist_str_equal, NULL, g_free);
+    flf->friends = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, flist_friend_free);
+    flf->cannot_bookmark = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 void flist_friends_unload(FListAccount *fla) {
@@ -32,6 +32,7 @@ gboolean flist_friends_is_bookmarked(FListAccount *fla, const gchar *character);
 //void flist_friends_remove_buddy(FListAccount *fla, const gchar* character);
 
 void flist_friends_login(FListAccount*);
+void flist_friends_mark_names(FListAccount *, FListBitset *keep);
 void flist_friends_load(FListAccount*);
 void flist_friends_unload(FListAccount*);
 
@@ -91,3 +91,140 @@ GHashTable *flist_web_request_args(FListAccount *fla) {
     if(ticket) g_hash_table_insert(ret, "ticket", g_strdup(ticket));
     return ret;
 }
+
+/* A decoder for the flat {"key":"value",...} objects that make up most of */
+/* the server traffic. It reads the values straight out of the frame into */
+/* the arena, and gives up (returning FALSE) on anything it doesn't expect, */
+/* in which case the caller should use a JsonParser instead. */
+
+static const gchar *flist_json_skip_ws(const gchar *cur, const gchar *end) {
+    while(cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r')) cur++;
+    return cur;
+}
+
+static gint flist_json_hex(const gchar *cur) {
+    gint ret = 0, i;
+    for(i = 0; i < 4; i++) {
+        gint digit = g_ascii_xdigit_value(cur[i]);
+        if(digit < 0) return -1;
+        ret = (ret << 4) | digit;
+    }
+    return ret;
+}
+
+/* cur points just past the opening quote */
+static const gchar *flist_json_read_string(FListArena *arena, const gchar *cur, const gchar *end, gchar **value) {
+    const gchar *start = cur;
+    gchar *out;
+    gsize out_len = 0;
+
+    while(cur < end && *cur != '"' && *cur != '\\') {
+        if((guchar) *cur < 0x20) return NULL;
+        cur++;
+    }
+    if(cur == end) return NULL;
+    if(*cur == '"') { /* the usual case: nothing to unescape */
+        if(value) *value = flist_arena_strndup(arena, start, (gsize) (cur - start));
+        return cur + 1;
+    }
+
+    /* unescaping never makes a string longer */
+    out = flist_arena_alloc(arena, (gsize) (end - start) + 1);
+    memcpy(out, start, (gsize) (cur - start));
+    out_len = (gsize) (cur - start);
+    while(cur < end && *cur != '"') {
+        gunichar c;
+        gint hex;
+        if((guchar) *cur < 0x20) return NULL;
+        if(*cur != '\\') {
+            out[out_len++] = *cur++;
+            continue;
+        }
+        if(++cur == end) return NULL;
+        switch(*cur++) {
+            case '"': out[out_len++] = '"'; break;
+            case '\\': out[out_len++] = '\\'; break;
+            case '/': out[out_len++] = '/'; break;
+            case 'b': out[out_len++] = '\b'; break;
+            case 'f': out[out_len++] = '\f'; break;
+            case 'n': out[out_len++] = '\n'; break;
+            case 'r': out[out_len++] = '\r'; break;
+            case 't': out[out_len++] = '\t'; break;
+            case 'u':
+                if(end - cur < 4 || (hex = flist_json_hex(cur)) < 0) return NULL;
+                c = (gunichar) hex;
+                cur += 4;
+                if(c >= 0xD800 && c < 0xDC00) { /* a surrogate pair */
+                    if(end - cur < 6 || cur[0] != '\\' || cur[1] != 'u') return NULL;
+                    hex = flist_json_hex(cur + 2);
+                    if(hex < 0xDC00 || hex >= 0xE000) return NULL;
+                    c = 0x10000 + ((c - 0xD800) << 10) + ((gunichar) hex - 0xDC00);
+                    cur += 6;
+                } else if(c == 0 || (c >= 0xDC00 && c < 0xE000)) {
+                    return NULL;
+                }
+                out_len += (gsize) g_unichar_to_utf8(c, out + out_len);
+                break;
+            default:
+                return NULL;
+        }
+    }
+    if(cur == end) return NULL;
+    out[out_len] = '\0';
+    if(value) *value = out;
+    return cur + 1;
+}
+
+gboolean flist_json_decode_flat(FListArena *arena, const gchar *data, gsize len, const gchar * const *keys, const gchar **values, guint n_keys) {
+    const gchar *cur = data, *end = data + len;
+    guint i;
+
+    for(i = 0; i < n_keys; i++) values[i] = NULL;
+
+    cur = flist_json_skip_ws(cur, end);
+    if(cur == end || *cur++ != '{') return FALSE;
+    cur = flist_json_skip_ws(cur, end);
+    if(cur < end && *cur == '}') {
+        cur++;
+    } else while(TRUE) {
+        const gchar *key;
+        gsize key_len;
+        gchar *value;
+        guint index = n_keys;
+
+        if(cur == end || *cur++ != '"') return FALSE;
+        key = cur;
+        while(cur < end && *cur != '"' && *cur != '\\') cur++;
+        if(cur == end || *cur != '"') return FALSE;
+        key_len = (gsize) (cur - key);
+        cur++;
+        for(i = 0; i < n_keys; i++) {
+            if(strlen(keys[i]) == key_len && !memcmp(keys[i], key, key_len)) {
+                index = i;
+                break;
+            }
+        }
+
+        cur = flist_json_skip_ws(cur, end);
+        if(cur == end || *cur++ != ':') return FALSE;
+        cur = flist_json_skip_ws(cur, end);
+        if(cur == end || *cur++ != '"') return FALSE; /* we only handle string values */
+        cur = flist_json_read_string(arena, cur, end, index < n_keys ? &value : NULL);
+        if(!cur) return FALSE;
+        if(index < n_keys) {
+            if(!g_utf8_validate(value, -1, NULL)) return FALSE;
+            values[index] = value;
+        }
+
+        cur = flist_json_skip_ws(cur, end);
+        if(cur == end) return FALSE;
+        if(*cur == '}') {
+            cur++;
+            break;
+        }
+        if(*cur++ != ',') return FALSE;
+        cur = flist_json_skip_ws(cur, end);
+    }
+
+    return flist_json_skip_ws(cur, end) == end;
+}
@@ -12,4 +12,6 @@ GHashTable *flist_web_request_args(FListAccount*);
 
 void flist_web_requests_init();
 
+gboolean flist_json_decode_flat(FListArena *, const gchar *data, gsize len, const gchar * const *keys, const gchar **values, guint n_keys);
+
 #endif	/* F_LIST_JSON_H */
@@ -32,6 +32,7 @@ const gchar *POSITIONS[7] = {"Always Top", "Usually Top", "Switch", "Usually Bot
 #define LAST_KINK3 "last_search3"
 #define LAST_GENDERS "last_search4"
 #define LAST_ROLES "last_search5"
+#define LAST_LIVE "last_search6"
 
 struct FListKinks_ {
     FListWebRequestData *global_kinks_request;
@@ -47,6 +48,16 @@ struct FListKinks_ {
     gboolean looking;
     int kink1, kink2, kink3;
     int genders, roles;
+    gboolean live;
+
+    /* While a live search is running, these hold what it was run with and */
+    /* which characters are in the search group, so that presence updates */
+    /* can add and remove single buddies. */
+    FListBitset *live_results;
+    FListBitset *live_kink_results; /* NULL if the search had no kinks */
+    gchar *live_channel;
+    gboolean live_looking;
+    int live_genders;
 };
 
 struct FListKink_ {
@@ -79,39 +90,127 @@ static int flist_filter_get_genders(FListKinks *flk) {
     return ret;
 }
 
+static void flist_filter_live_stop(FListAccount *fla) {
+    FListKinks *flk = _flist_kinks(fla);
+    
+    if(flk->live_results) flist_bitset_free(flk->live_results);
+    if(flk->live_kink_results) flist_bitset_free(flk->live_kink_results);
+    if(flk->live_channel) g_free(flk->live_channel);
+    flk->live_results = NULL;
+    flk->live_kink_results = NULL;
+    flk->live_channel = NULL;
+}
+
+/* takes the kink results, if there are any, and copies the result set; */
+/* channel is the one the search was narrowed to, if it was */
+static void flist_filter_live_start(FListAccount *fla, int genders, const gchar *channel, FListBitset *kink_results, FListBitset *results) {
+    FListKinks *flk = _flist_kinks(fla);
+    
+    flist_filter_live_stop(fla);
+    flk->live_looking = flk->looking;
+    flk->live_genders = genders;
+    flk->live_channel = g_strdup(channel);
+    flk->live_kink_results = kink_results;
+    flk->live_results = flist_bitset_new();
+    flist_bitset_copy(flk->live_results, results);
+}
+
+static gboolean flist_filter_live_matches(FListAccount *fla, FListCharacter *character) {
+    FListKinks *flk = _flist_kinks(fla);
+    
+    if(flk->live_looking && character->status != FLIST_STATUS_LOOKING) return FALSE;
+    if(!(character->gender & flk->live_genders)) return FALSE;
+    if(flk->live_kink_results && !flist_bitset_contains(flk->live_kink_results, character->id)) return FALSE;
+    if(flk->live_channel) {
+        /* leaving the channel stops the search, so this shouldn't be missing */
+        FListChannel *fchannel = flist_channel_find(fla, flk->live_channel);
+        if(!fchannel) return FALSE;
+        if(!g_hash_table_lookup_extended(fchannel->users, GUINT_TO_POINTER(character->id), NULL, NULL)) return FALSE;
+    }
+    return TRUE;
+}
+
+void flist_filter_character_changed(FListAccount *fla, FListCharacter *character) {
+    FListKinks *flk = _flist_kinks(fla);
+    gboolean matches;
+    
+    if(!flk || !flk->live_results || !character) return;
+    
+    matches = flist_filter_live_matches(fla, character);
+    if(matches == flist_bitset_contains(flk->live_results, character->id)) return;
+    if(matches) {
+        flist_bitset_add(flk->live_results, character->id);
+        flist_filter_add_buddy(fla, character->name);
+    } else {
+        flist_bitset_remove(flk->live_results, character->id);
+        flist_filter_remove_buddy(fla, character->name);
+    }
+}
+
+void flist_filter_character_offline(FListAccount *fla, const gchar *name) {
+    FListKinks *flk = _flist_kinks(fla);
+    guint id;
+    
+    if(!flk || !flk->live_results) return;
+    
+    id = flist_name_id(fla->names, name);
+    if(!id || !flist_bitset_contains(flk->live_results, id)) return;
+    flist_bitset_remove(flk->live_results, id);
+    flist_filter_remove_buddy(fla, name);
+}
+
+/* The search group stays as it is, but we can't tell who is in the */
+/* channel any more, so it isn't kept up to date. */
+void flist_filter_channel_left(FListAccount *fla, const gchar *name) {
+    FListKinks *flk = _flist_kinks(fla);
+    
+    if(!flk || !flk->live_results || !flk->live_channel || !flist_str_equal(flk->live_channel, name)) return;
+    
+    purple_debug_info(FLIST_DEBUG, "We left %s, so the live search on it has stopped.\n", name);
+    flist_filter_live_stop(fla);
+}
+
+/* for flist_names_collect: the kink results can name characters who */
+/* have gone offline, and their IDs mustn't go to someone else */
+void flist_filter_mark_names(FListAccount *fla, FListBitset *keep) {
+    FListKinks *flk = _flist_kinks(fla);
+
+    if(!flk || !flk->live_results) return;
+    flist_bitset_union(keep, flk->live_results);
+    if(flk->live_kink_results) flist_bitset_union(keep, flk->live_kink_results);
+}
+
+/* Every part of the search is a set of character IDs, and the result is */
+/* their intersection. Only the names that come out at the end are listed. */
 static GSList *flist_get_filter_characters(FListAccount *fla, gboolean has_extra, GSList *extra) {
     FListKinks *flk = _flist_kinks(fla);
-    GSList *all, *cur;
-    GSList *ret = NULL, *names = NULL;
+    GSList *cur;
+    GSList *names = NULL;
     int genders = flist_filter_get_genders(flk);
+    FListBitset *matches = flist_bitset_new();
+    FListBitset *kink_results = NULL;
+    const gchar *channel = NULL;
+    guint id = 0;
     
-    /* get the initial list by filtering by gender and status */
-    all = flist_get_all_characters(fla);
-    cur = all;
-    while(cur) {
-        FListCharacter *character = cur->data;
-        if(!flk->looking || character->status == FLIST_STATUS_LOOKING)
-            if(character->gender & genders)
-                ret = g_slist_prepend(ret, character);
-        cur = g_slist_next(cur);
-    }
-    g_slist_free(all);
+    /* start with the status and gender indexes */
+    flist_characters_filter(fla, matches, flk->looking, genders);
+    purple_debug_info(FLIST_DEBUG, "%u characters match the status and gender filter.\n", flist_bitset_count(matches));
     
     /* if there is a channel chosen, filter by that, too */
     if(fla->filter_channel) {
-        PurpleConversation *convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, fla->filter_channel, fla->pa);
-        if(convo) {
-            GSList *tmp = NULL;
+        FListChannel *fchannel = flist_channel_find(fla, fla->filter_channel);
+        if(fchannel) {
+            FListBitset *channel_users = flist_bitset_new();
+            GHashTableIter iter;
+            gpointer key;
             purple_debug_info("flist", "We filtered on channel %s.\n", fla->filter_channel);
-            //TODO: do we have to clean this up when we're done with it? The API is unclear.
-            GList *chat_users = purple_conv_chat_get_users(PURPLE_CONV_CHAT(convo));
-            while(chat_users) {
-                PurpleConvChatBuddy *b = chat_users->data;
-                FListCharacter *character = flist_get_character(fla, b->name);
-                if(character) tmp = g_slist_prepend(tmp, character);
-                chat_users = g_list_next(chat_users);
+            g_hash_table_iter_init(&iter, fchannel->users);
+            while(g_hash_table_iter_next(&iter, &key, NULL)) {
+                flist_bitset_add(channel_users, GPOINTER_TO_UINT(key));
             }
-            ret = flist_g_slist_intersect_and_free(ret, tmp);
+            flist_bitset_intersect(matches, channel_users);
+            flist_bitset_free(channel_users);
+            channel = fla->filter_channel;
         } else {
             purple_debug_info("flist", "We tried to filter on channel %s, but no channel was found.\n", fla->filter_channel);
         }
@@ -119,23 +218,30 @@ static GSList *flist_get_filter_characters(FListAccount *fla, gboolean has_extra
     
     /* if we have server-side results, filter by them last */
     if(has_extra) {
-        GSList *tmp = NULL;
-        cur = extra;
-        while(cur) {
-            FListCharacter *character = flist_get_character(fla, cur->data);
-            if(character) tmp = g_slist_prepend(tmp, character);
-            cur = g_slist_next(cur);
+        /* FKS only lists characters who are online now, so a live search */
+        /* can't match anyone who logs in later. They should all have IDs, */
+        /* and one that hasn't can't be in the other sets anyway. */
+        kink_results = flist_bitset_new();
+        for(cur = extra; cur; cur = g_slist_next(cur)) {
+            guint kink_id = flist_name_id(fla->names, cur->data);
+            if(kink_id) flist_bitset_add(kink_results, kink_id);
         }
-        ret = flist_g_slist_intersect_and_free(ret, tmp);
+        flist_bitset_intersect(matches, kink_results);
     }
     
-    cur = ret;
-    while(cur) {
-        FListCharacter *character = cur->data;
-        names = g_slist_prepend(names, character->name);
-        cur = g_slist_next(cur);
+    /* remember the search, or forget the last one */
+    if(flk->live) {
+        flist_filter_live_start(fla, genders, channel, kink_results, matches);
+    } else {
+        flist_filter_live_stop(fla);
+        if(kink_results) flist_bitset_free(kink_results);
+    }
+    
+    while(flist_bitset_next(matches, &id)) {
+        names = g_slist_prepend(names, (gpointer) flist_name_get(fla->names, id));
+        id++;
     }
-    g_slist_free(ret);
+    flist_bitset_free(matches);
     
     return names;
 }
@@ -247,6 +353,7 @@ static void flist_filter_done(FListAccount *fla) {
     purple_account_set_int(fla->pa, LAST_KINK3, flk->kink3);
     purple_account_set_int(fla->pa, LAST_LOOKING, flk->looking);
     purple_account_set_int(fla->pa, LAST_ROLES, flk->roles);
+    purple_account_set_bool(fla->pa, LAST_LIVE, flk->live);
     
     fla->input_request = FALSE;
 }
@@ -262,8 +369,16 @@ static void flist_filter_cancel(gpointer user_data) {
     fla->input_request = FALSE;
 }
 
-static void flist_filter_dialog(FListAccount *fla, PurpleRequestFields *fields, GCallback callback) {
-    purple_request_fields(fla->pc, _("Character Search!"), _("Search for characters on the F-List server."), _("Please fill out the search form."),
+/* once kinks and live results are both chosen, say what live results can't do */
+static const gchar *flist_filter_secondary(FListKinks *flk) {
+    if(flk->live && (flk->kink1 || flk->kink2 || flk->kink3)) {
+        return _("Please fill out the search form. Because kinks are chosen, keeping the results updated can't add characters who log in after the search.");
+    }
+    return _("Please fill out the search form.");
+}
+
+static void flist_filter_dialog(FListAccount *fla, const gchar *secondary, PurpleRequestFields *fields, GCallback callback) {
+    purple_request_fields(fla->pc, _("Character Search!"), _("Search for characters on the F-List server."), secondary,
         fields,
         _("OK"), callback,
         _("Cancel"), G_CALLBACK(flist_filter_cancel),
@@ -287,7 +402,7 @@ static void flist_filter3(FListAccount *fla) {
     flist_filter_pack(group, "role", flk->filter_role_choices, flk->roles);
     purple_request_fields_add_group(fields, group);
         
-    flist_filter_dialog(fla, fields, G_CALLBACK(flist_filter3_cb));
+    flist_filter_dialog(fla, flist_filter_secondary(flk), fields, G_CALLBACK(flist_filter3_cb));
 }
 
 static void flist_filter2_cb(gpointer user_data, PurpleRequestFields *fields) {
@@ -307,7 +422,7 @@ static void flist_filter2(FListAccount *fla) {
     purple_request_fields_add_group(fields, group);
     flist_filter_pack(group, "gender", flk->filter_gender_choices, flk->genders);
     
-    flist_filter_dialog(fla, fields, G_CALLBACK(flist_filter2_cb));
+    flist_filter_dialog(fla, flist_filter_secondary(flk), fields, G_CALLBACK(flist_filter2_cb));
 }
 
 static void flist_filter1_cb(gpointer user_data, PurpleRequestFields *fields) {
@@ -323,6 +438,7 @@ static void flist_filter1_cb(gpointer user_data, PurpleRequestFields *fields) {
 
     /* this is a client-side filter */
     flk->looking = purple_request_fields_get_bool(fields, "looking");
+    flk->live = purple_request_fields_get_bool(fields, "live");
     
     /* this is a client-side filter*/
     channel_index = purple_request_fields_get_choice(fields, "channel");
@@ -363,6 +479,9 @@ static void flist_filter1(FListAccount *fla) {
     field = purple_request_field_bool_new("looking", "Looking Only", flk->looking);
     purple_request_field_group_add_field(group, field);
 
+    field = purple_request_field_bool_new("live", "Keep Results Updated", flk->live);
+    purple_request_field_group_add_field(group, field);
+
     /* now, add all of our current channels to the list */
     field = purple_request_field_choice_new("channel", _("Channel"), 0);
     purple_request_field_choice_add(field, "(No Filter)");
@@ -384,7 +503,7 @@ static void flist_filter1(FListAccount *fla) {
         flist_add_kink_field(flk, group, "kink3", flk->kink3);
     }
     
-    flist_filter_dialog(fla, fields, G_CALLBACK(flist_filter1_cb));
+    flist_filter_dialog(fla, _("Please fill out the search form."), fields, G_CALLBACK(flist_filter1_cb));
 }
 
 static void flist_filter_real(PurpleConnection *pc) {
@@ -497,6 +616,7 @@ void flist_global_kinks_load(PurpleConnection *pc) {
     flk->genders = purple_account_get_int(fla->pa, LAST_GENDERS, 0xFFFFFFFF);
     flk->roles = purple_account_get_int(fla->pa, LAST_ROLES, 0xFFFFFFFF);
     flk->looking = purple_account_get_bool(fla->pa, LAST_LOOKING, TRUE);
+    flk->live = purple_account_get_bool(fla->pa, LAST_LIVE, FALSE);
 }
 
 void flist_global_kinks_unload(PurpleConnection *pc) {
@@ -528,6 +648,7 @@ void flist_global_kinks_unload(PurpleConnection *pc) {
     if(flk->filter_role_choices) {
         flist_g_slist_free_full(flk->filter_role_choices, (GDestroyNotify) g_free);
     }
+    flist_filter_live_stop(fla);
     
     g_free(flk);
     fla->flist_kinks = NULL;
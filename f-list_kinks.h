@@ -29,6 +29,12 @@ gboolean flist_process_FKS(PurpleConnection *, JsonObject *);
 
 void flist_filter_action(PurplePluginAction *action);
 
+/* keep a live search up to date; these do nothing if none is running */
+void flist_filter_character_changed(FListAccount *, FListCharacter *);
+void flist_filter_character_offline(FListAccount *, const gchar *name);
+void flist_filter_channel_left(FListAccount *, const gchar *name);
+void flist_filter_mark_names(FListAccount *, FListBitset *keep);
+
 void flist_global_kinks_load(PurpleConnection *);
 void flist_global_kinks_unload(PurpleConnection *);
 
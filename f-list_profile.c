@@ -265,7 +265,7 @@ void flist_get_profile(PurpleConnection *pc, const char *who) {
     } else {
         purple_notify_user_info_add_pair(flp->profile_info, "Status", flist_format_status(character->status));
         purple_notify_user_info_add_pair(flp->profile_info, "Gender", flist_format_gender(character->gender));
-        purple_notify_user_info_add_pair(flp->profile_info, "Message", character->status_message);
+        purple_notify_user_info_add_pair(flp->profile_info, "Message", flist_character_get_status_message_escaped(character));
     }
     purple_notify_user_info_add_pair(flp->profile_info, "Link", link);
     purple_notify_userinfo(pc, flp->character, flp->profile_info, NULL, NULL);
@@ -23,14 +23,12 @@
 //This file is currently mostly unnecessary, but more will likely be added later.
 
 void flist_update_server_status(FListAccount *fla) {
-    JsonObject *json = json_object_new();
+    GString *frame = flist_frame_new(FLIST_SET_STATUS);
     const gchar *status = purple_account_get_string(fla->pa, "_status", "online");
     const gchar *status_message = purple_account_get_string(fla->pa, "_status_message", "");
-    json_object_set_string_member(json, "status", status);
-    json_object_set_string_member(json, "statusmsg", status_message);
-    flist_request(fla->pc, FLIST_SET_STATUS, json);
-    
-    json_object_unref(json);
+    flist_frame_add_string(frame, "status", status);
+    flist_frame_add_string(frame, "statusmsg", status_message);
+    flist_frame_send(fla->pc, frame);
 }
 
 void flist_set_status(FListAccount *fla, FListStatus status, const gchar *status_message) {
@@ -0,0 +1,391 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "f-list_websocket.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/* RFC 6455 framing for the chat connection, with permessage-deflate */
+/* (RFC 7692) for incoming messages. We never compress what we send; the */
+/* commands we send are small, and the extension allows it. */
+
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+/* refuse anything bigger than this, compressed or not */
+#define FLIST_WEBSOCKET_MAX_MESSAGE (64 * 1024 * 1024)
+#define FLIST_INFLATE_CHUNK 16384
+
+#define WEBSOCKET_OP_CONTINUATION 0x0
+#define WEBSOCKET_OP_TEXT 0x1
+#define WEBSOCKET_OP_BINARY 0x2
+#define WEBSOCKET_OP_CLOSE 0x8
+#define WEBSOCKET_OP_PING 0x9
+#define WEBSOCKET_OP_PONG 0xA
+
+struct FListWebSocket_ {
+    gchar *key; /* the Sec-WebSocket-Key we sent */
+    gboolean offer_deflate;
+    gboolean deflate; /* the server accepted permessage-deflate */
+    gboolean no_context_takeover; /* the server resets its compressor for each message */
+
+    gboolean in_message; /* we are in the middle of a fragmented message */
+    gboolean message_compressed;
+    GString *message; /* fragments received so far */
+    GString *inflated;
+#ifdef HAVE_ZLIB
+    z_stream inflater;
+#endif
+
+    guint64 stat_messages;
+    guint64 stat_compressed_in;
+    guint64 stat_inflated_out;
+};
+
+FListWebSocket *flist_websocket_new(gboolean compress) {
+    FListWebSocket *ws = g_new0(FListWebSocket, 1);
+    guint32 nonce[4];
+    int i;
+
+    for(i = 0; i < 4; i++) nonce[i] = g_random_int();
+    ws->key = g_base64_encode((const guchar *) nonce, sizeof(nonce));
+    ws->message = g_string_new(NULL);
+    ws->inflated = g_string_new(NULL);
+
+#ifdef HAVE_ZLIB
+    /* raw deflate, with the largest window the server may use */
+    if(compress && inflateInit2(&ws->inflater, -15) == Z_OK) {
+        ws->offer_deflate = TRUE;
+    }
+#endif
+
+    return ws;
+}
+
+void flist_websocket_free(FListWebSocket *ws) {
+#ifdef HAVE_ZLIB
+    if(ws->offer_deflate) inflateEnd(&ws->inflater);
+#endif
+    g_string_free(ws->message, TRUE);
+    g_string_free(ws->inflated, TRUE);
+    g_free(ws->key);
+    g_free(ws);
+}
+
+GString *flist_websocket_handshake(FListWebSocket *ws, const gchar *host, gint port) {
+    GString *headers = g_string_new(NULL);
+
+    g_string_append(headers, "GET / HTTP/1.1\r\n");
+    g_string_append_printf(headers, "Host: %s:%d\r\n", host, port);
+    g_string_append(headers, "Upgrade: websocket\r\n");
+    g_string_append(headers, "Connection: Upgrade\r\n");
+    g_string_append(headers, "Origin: http://www.f-list.net\r\n");
+    g_string_append_printf(headers, "Sec-WebSocket-Key: %s\r\n", ws->key);
+    g_string_append(headers, "Sec-WebSocket-Version: 13\r\n");
+    if(ws->offer_deflate) {
+        g_string_append(headers, "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n");
+    }
+    g_string_append(headers, "\r\n");
+
+    return headers;
+}
+
+static gchar *flist_websocket_accept_key(const gchar *key) {
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA1);
+    guint8 digest[20];
+    gsize digest_len = sizeof(digest);
+
+    g_checksum_update(checksum, (const guchar *) key, -1);
+    g_checksum_update(checksum, (const guchar *) WEBSOCKET_GUID, -1);
+    g_checksum_get_digest(checksum, digest, &digest_len);
+    g_checksum_free(checksum);
+
+    return g_base64_encode(digest, digest_len);
+}
+
+static void flist_websocket_parse_extensions(FListWebSocket *ws, const gchar *value) {
+    gchar **params = g_strsplit(value, ";", -1);
+    gchar **cur;
+
+    if(!params[0] || g_ascii_strcasecmp(g_strstrip(params[0]), "permessage-deflate")) {
+        g_strfreev(params);
+        return;
+    }
+    ws->deflate = TRUE;
+    for(cur = params + 1; *cur; cur++) {
+        if(!g_ascii_strcasecmp(g_strstrip(*cur), "server_no_context_takeover")) {
+            ws->no_context_takeover = TRUE;
+        }
+    }
+    g_strfreev(params);
+}
+
+gboolean flist_websocket_handle_handshake(PurpleConnection *pc) {
+    FListAccount *fla = pc->proto_data;
+    FListWebSocket *ws = fla->websocket;
+    gsize len = flist_rx_buffer_length(fla->rx_buf);
+    const gchar *data = flist_rx_buffer_peek(fla->rx_buf, len);
+    const gchar *end = g_strstr_len(data, len, "\r\n\r\n");
+    gchar *response, *expected;
+    gchar **lines, **cur;
+    gboolean upgraded = FALSE, accepted = FALSE;
+
+    if(!end) return FALSE; //we don't have the whole response yet
+
+    response = g_strndup(data, (gsize) (end - data));
+    flist_rx_buffer_consume(fla->rx_buf, (gsize) (end - data) + 4);
+    if(fla->debug_mode) {
+        purple_debug_info(FLIST_DEBUG, "WebSocket handshake response:\n%s\n", response);
+    }
+
+    lines = g_strsplit(response, "\r\n", -1);
+    g_free(response);
+    if(!lines[0] || !strstr(lines[0], " 101")) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "The server refused the WebSocket connection.");
+        g_strfreev(lines);
+        return FALSE;
+    }
+
+    expected = flist_websocket_accept_key(ws->key);
+    for(cur = lines + 1; *cur; cur++) {
+        gchar *colon = strchr(*cur, ':');
+        gchar *name, *value;
+        if(!colon) continue;
+        *colon = '\0';
+        name = g_strstrip(*cur);
+        value = g_strstrip(colon + 1);
+        if(!g_ascii_strcasecmp(name, "Upgrade")) {
+            upgraded = !g_ascii_strcasecmp(value, "websocket");
+        } else if(!g_ascii_strcasecmp(name, "Sec-WebSocket-Accept")) {
+            accepted = !strcmp(value, expected);
+        } else if(!g_ascii_strcasecmp(name, "Sec-WebSocket-Extensions") && ws->offer_deflate) {
+            flist_websocket_parse_extensions(ws, value);
+        }
+    }
+    g_free(expected);
+    g_strfreev(lines);
+
+    if(!upgraded || !accepted) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket handshake response.");
+        return FALSE;
+    }
+
+    purple_debug_info(FLIST_DEBUG, "WebSocket connection established (compression: %s).\n", ws->deflate ? "on" : "off");
+    flist_IDN(pc);
+    fla->connection_status = FLIST_IDENTIFY;
+    return TRUE;
+}
+
+static gsize flist_websocket_frame(GString *message, gsize headroom, guint8 opcode) {
+    gsize payload_len = message->len - headroom;
+    gsize header_len = 2 + 4;
+    guint8 *header, *mask, *payload;
+    guint32 key = g_random_int();
+    gsize i;
+
+    if(payload_len >= 65536) header_len += 8;
+    else if(payload_len >= 126) header_len += 2;
+    g_return_val_if_fail(header_len <= headroom, 0);
+
+    header = (guint8 *) message->str + headroom - header_len;
+    header[0] = 0x80 | opcode; /* FIN, never fragmented */
+    if(payload_len >= 65536) {
+        header[1] = 0x80 | 127;
+        for(i = 0; i < 8; i++) header[2 + i] = (guint8) (((guint64) payload_len) >> (8 * (7 - i)));
+    } else if(payload_len >= 126) {
+        header[1] = 0x80 | 126;
+        header[2] = (guint8) (payload_len >> 8);
+        header[3] = (guint8) payload_len;
+    } else {
+        header[1] = 0x80 | (guint8) payload_len;
+    }
+
+    /* clients have to mask everything they send */
+    mask = (guint8 *) message->str + headroom - 4;
+    memcpy(mask, &key, 4);
+    payload = (guint8 *) message->str + headroom;
+    for(i = 0; i < payload_len; i++) payload[i] ^= mask[i & 3];
+
+    return headroom - header_len;
+}
+
+gsize flist_websocket_wrap(GString *message, gsize headroom) {
+    return flist_websocket_frame(message, headroom, WEBSOCKET_OP_TEXT);
+}
+
+static void flist_websocket_send_control(FListAccount *fla, guint8 opcode, const gchar *payload, gsize len) {
+    GString *frame = g_string_sized_new(FLIST_WEBSOCKET_HEADROOM + len);
+    g_string_set_size(frame, FLIST_WEBSOCKET_HEADROOM);
+    g_string_append_len(frame, payload, (gssize) len);
+    flist_send_raw(fla, frame, flist_websocket_frame(frame, FLIST_WEBSOCKET_HEADROOM, opcode));
+}
+
+static gboolean flist_websocket_inflate(PurpleConnection *pc, FListWebSocket *ws) {
+#ifdef HAVE_ZLIB
+    gsize out_len = 0;
+    int ret;
+
+    /* the sender strips the end of the final deflate block, so we put it back */
+    g_string_append_len(ws->message, "\x00\x00\xff\xff", 4);
+    ws->inflater.next_in = (Bytef *) ws->message->str;
+    ws->inflater.avail_in = (uInt) ws->message->len;
+    do {
+        if(out_len >= FLIST_WEBSOCKET_MAX_MESSAGE) {
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (message too large).");
+            return FALSE;
+        }
+        g_string_set_size(ws->inflated, out_len + FLIST_INFLATE_CHUNK);
+        ws->inflater.next_out = (Bytef *) ws->inflated->str + out_len;
+        ws->inflater.avail_out = FLIST_INFLATE_CHUNK;
+        ret = inflate(&ws->inflater, Z_SYNC_FLUSH);
+        out_len += FLIST_INFLATE_CHUNK - ws->inflater.avail_out;
+        if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (bad compressed data).");
+            return FALSE;
+        }
+    } while(ws->inflater.avail_out == 0 || (ws->inflater.avail_in > 0 && ret == Z_OK));
+    g_string_set_size(ws->inflated, out_len);
+
+    if(ws->no_context_takeover || ret == Z_STREAM_END) inflateReset(&ws->inflater);
+
+    ws->stat_compressed_in += ws->message->len - 4;
+    ws->stat_inflated_out += out_len;
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/* Handles one WebSocket frame from the receive buffer. Returns FALSE when */
+/* there isn't a complete frame yet, or when the connection failed. */
+gboolean flist_websocket_handle_input(PurpleConnection *pc) {
+    FListAccount *fla = pc->proto_data;
+    FListWebSocket *ws = fla->websocket;
+    gsize available = flist_rx_buffer_length(fla->rx_buf);
+    const guint8 *header;
+    const gchar *payload;
+    gsize header_len = 2, frame_len;
+    guint64 payload_len;
+    gboolean fin, compressed;
+    guint8 opcode;
+    gboolean ret = TRUE;
+    int i;
+
+    if(available < header_len) return FALSE;
+    header = (const guint8 *) flist_rx_buffer_peek(fla->rx_buf, header_len);
+    fin = (header[0] & 0x80) != 0;
+    compressed = (header[0] & 0x40) != 0;
+    opcode = header[0] & 0x0F;
+    if(header[0] & 0x30 || (compressed && !ws->deflate)) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (unknown extension).");
+        return FALSE;
+    }
+    if(header[1] & 0x80) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (masked frame from the server).");
+        return FALSE;
+    }
+
+    payload_len = header[1] & 0x7F;
+    if(payload_len == 126) header_len += 2;
+    else if(payload_len == 127) header_len += 8;
+    if(available < header_len) return FALSE;
+    if(header_len > 2) {
+        header = (const guint8 *) flist_rx_buffer_peek(fla->rx_buf, header_len);
+        payload_len = 0;
+        for(i = 2; i < header_len; i++) payload_len = (payload_len << 8) | header[i];
+    }
+    if(payload_len > FLIST_WEBSOCKET_MAX_MESSAGE || ws->message->len + payload_len > FLIST_WEBSOCKET_MAX_MESSAGE) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (message too large).");
+        return FALSE;
+    }
+
+    frame_len = header_len + (gsize) payload_len;
+    if(available < frame_len) return FALSE; //we don't have the whole frame yet
+    payload = flist_rx_buffer_peek(fla->rx_buf, frame_len) + header_len;
+
+    if(opcode & 0x08) { /* control frames can show up between fragments */
+        if(!fin || payload_len > 125 || compressed) {
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (bad control frame).");
+            return FALSE;
+        }
+        switch(opcode) {
+        case WEBSOCKET_OP_PING:
+            flist_websocket_send_control(fla, WEBSOCKET_OP_PONG, payload, (gsize) payload_len);
+            break;
+        case WEBSOCKET_OP_PONG:
+            break;
+        case WEBSOCKET_OP_CLOSE:
+            /* echo the status code back, as the protocol asks */
+            flist_websocket_send_control(fla, WEBSOCKET_OP_CLOSE, payload, MIN((gsize) payload_len, 2));
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "The server closed the connection.");
+            ret = FALSE;
+            break;
+        default:
+            purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (unknown opcode).");
+            ret = FALSE;
+        }
+        flist_rx_buffer_consume(fla->rx_buf, frame_len);
+        return ret;
+    }
+
+    if(opcode != WEBSOCKET_OP_CONTINUATION && opcode != WEBSOCKET_OP_TEXT && opcode != WEBSOCKET_OP_BINARY) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (unknown opcode).");
+        return FALSE;
+    }
+    if(opcode == WEBSOCKET_OP_CONTINUATION ? (!ws->in_message || compressed) : ws->in_message) {
+        purple_connection_error_reason(pc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR, "Invalid WebSocket data (unexpected fragment).");
+        return FALSE;
+    }
+
+    if(opcode != WEBSOCKET_OP_CONTINUATION && fin && !compressed) {
+        /* the usual case: a whole message, which we handle in place */
+        ws->stat_messages++;
+        ret = flist_handle_message(pc, payload, (gsize) payload_len);
+        flist_rx_buffer_consume(fla->rx_buf, frame_len);
+        return ret;
+    }
+
+    if(opcode != WEBSOCKET_OP_CONTINUATION) {
+        ws->in_message = TRUE;
+        ws->message_compressed = compressed;
+        g_string_truncate(ws->message, 0);
+    }
+    g_string_append_len(ws->message, payload, (gssize) payload_len);
+    flist_rx_buffer_consume(fla->rx_buf, frame_len);
+    if(!fin) return TRUE;
+
+    ws->in_message = FALSE;
+    ws->stat_messages++;
+    if(ws->message_compressed) {
+        if(!flist_websocket_inflate(pc, ws)) return FALSE;
+        return flist_handle_message(pc, ws->inflated->str, ws->inflated->len);
+    }
+    return flist_handle_message(pc, ws->message->str, ws->message->len);
+}
+
+void flist_websocket_stats(FListWebSocket *ws, GString *str) {
+    g_string_append_printf(str, "WebSocket: %" G_GUINT64_FORMAT " messages, compression %s",
+        ws->stat_messages, ws->deflate ? "on" : "off");
+    if(ws->stat_compressed_in > 0) {
+        g_string_append_printf(str, " (%" G_GUINT64_FORMAT " bytes inflated to %" G_GUINT64_FORMAT ")",
+            ws->stat_compressed_in, ws->stat_inflated_out);
+    }
+    g_string_append(str, "<br>");
+}
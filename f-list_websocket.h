@@ -0,0 +1,41 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLIST_WEBSOCKET_H
+#define	FLIST_WEBSOCKET_H
+
+#include "f-list.h"
+
+/* outgoing messages leave this much room in front for the frame header */
+#define FLIST_WEBSOCKET_HEADROOM 14
+
+FListWebSocket *flist_websocket_new(gboolean compress);
+void flist_websocket_free(FListWebSocket *);
+
+GString *flist_websocket_handshake(FListWebSocket *, const gchar *host, gint port);
+gboolean flist_websocket_handle_handshake(PurpleConnection *);
+gboolean flist_websocket_handle_input(PurpleConnection *);
+
+/* frames the message in place; returns the offset the frame starts at */
+gsize flist_websocket_wrap(GString *message, gsize headroom);
+
+void flist_websocket_stats(FListWebSocket *, GString *);
+
+#endif	/* FLIST_WEBSOCKET_H */
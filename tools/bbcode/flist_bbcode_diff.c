@@ -0,0 +1,157 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "f-list_bbcode.h"
+#include "flist_bbcode_old.h"
+
+#include <stdio.h>
+
+/* Feeds the same generated messages to the current converter and to the */
+/* one it replaced (flist_bbcode_old.c), and reports every message they */
+/* convert differently. The messages are built from a seeded generator out */
+/* of tag fragments, broken tags, deep nesting and text that needs care, */
+/* so a failure can be reproduced with the seed and message number. Each */
+/* message is converted without an account, with an account, and with an */
+/* account and a conversation, the last one also fetching icons, and */
+/* stripped. */
+
+#define DIFF_MAX_LENGTH 4096
+#define DIFF_MAX_REPORTED 10
+
+static gint seed = 1;
+static gint count = 100000;
+static gboolean verbose = FALSE;
+
+static GOptionEntry options[] = {
+    { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Seed for the generated messages (default 1)", "SEED" },
+    { "count", 'n', 0, G_OPTION_ARG_INT, &count, "Check this many messages (default 100000)", "COUNT" },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print every difference, not just the first few", NULL },
+    { NULL }
+};
+
+static const gchar *fragments[] = {
+    "[b]", "[/b]", "[i]", "[/i]", "[u]", "[/u]", "[s]", "[/s]",
+    "[url]", "[/url]", "[url=http://www.f-list.net/]", "[url=http://x\"y]", "[url=]", "[url=a=b]",
+    "[color=red]", "[color=]", "[color=\"red\"]", "[/color]",
+    "[user]", "[/user]", "[icon]", "[/icon]",
+    "[channel]", "[/channel]", "[session=Title]", "[session]", "[/session]",
+    "[", "]", "[/", "=", "[]", "[/]", "[=x]", "[bb]", "[B]", "[b=arg]", "[/b=x]",
+    "[i][b]", "[/i][/b]", "[[b]]", "x]y", "[color=blue", "[/url",
+    "text", "Hello World", "ADH-1234", " ", "\"", "<&>", "&amp;", "\xc3\xa9", "\xe2\x9c\x93"
+};
+
+/* the converters are only told about icons through here */
+static GString *fetched;
+
+void flist_fetch_emoticon(FListAccount *fla, const gchar *smiley, const gchar *character, PurpleConversation *convo) {
+    g_string_append_printf(fetched, "%s|%s\n", smiley, character);
+}
+
+const gchar *flist_serialize_account(PurpleAccount *pa) {
+    return "diff:Diff Tester";
+}
+
+static gchar *diff_message(GRand *rand) {
+    GString *message = g_string_new(NULL);
+    gint pieces = g_rand_int_range(rand, 0, 30), i, depth;
+
+    for(i = 0; i < pieces && message->len < DIFF_MAX_LENGTH; i++) {
+        /* now and then, nest deeper than the new converter's stack */
+        if(g_rand_int_range(rand, 0, 8) == 0) {
+            depth = g_rand_int_range(rand, 0, 40);
+            while(depth--) g_string_append(message, "[b]");
+        }
+        g_string_append(message, fragments[g_rand_int_range(rand, 0, G_N_ELEMENTS(fragments))]);
+    }
+    return g_string_free(message, FALSE);
+}
+
+static gboolean diff_check(guint number, const gchar *mode, const gchar *message, gchar *old, const gchar *old_fetched, gchar *new) {
+    gboolean same = !strcmp(old, new) && !strcmp(old_fetched, fetched->str);
+    static guint reported = 0;
+
+    if(!same && (verbose || reported++ < DIFF_MAX_REPORTED)) {
+        printf("message %u (%s): %s\n", number, mode, message);
+        printf("  old: %s\n  new: %s\n", old, new);
+        if(strcmp(old_fetched, fetched->str)) {
+            printf("  old icons:\n%s  new icons:\n%s", old_fetched, fetched->str);
+        }
+    }
+    g_free(old);
+    g_free(new);
+    return same;
+}
+
+int main(int argc, char *argv[]) {
+    GOptionContext *context;
+    GError *err = NULL;
+    GRand *rand;
+    FListAccount fla;
+    PurpleConversation *convo;
+    gchar *message, *old, *old_fetched;
+    guint number, differences = 0, checks = 0;
+    gint mode;
+    const gchar *modes[] = { "no account", "account", "conversation" };
+
+    context = g_option_context_new("- compare the BBCode converter with the one it replaced");
+    g_option_context_add_main_entries(context, options, NULL);
+    if(!g_option_context_parse(context, &argc, &argv, &err) || argc != 1) {
+        fprintf(stderr, "%s", err ? err->message : g_option_context_get_help(context, TRUE, NULL));
+        return 1;
+    }
+    g_option_context_free(context);
+
+    flist_bbcode_old_init();
+    fetched = g_string_new(NULL);
+    rand = g_rand_new_with_seed((guint32) seed);
+    memset(&fla, 0, sizeof(fla));
+    /* the converters only pass it on to flist_fetch_emoticon */
+    convo = (PurpleConversation *) &fla;
+
+    for(number = 0; number < (guint) count; number++) {
+        message = diff_message(rand);
+
+        for(mode = 0; mode < 3; mode++) {
+            FListAccount *mode_fla = mode > 0 ? &fla : NULL;
+            PurpleConversation *mode_convo = mode > 1 ? convo : NULL;
+
+            g_string_truncate(fetched, 0);
+            old = flist_bbcode_old_to_html(mode_fla, mode_convo, message, FALSE);
+            old_fetched = g_strdup(fetched->str);
+            g_string_truncate(fetched, 0);
+            if(!diff_check(number, modes[mode], message, old, old_fetched,
+                    flist_bbcode_to_html(mode_fla, mode_convo, message))) differences++;
+            g_free(old_fetched);
+            checks++;
+        }
+
+        g_string_truncate(fetched, 0);
+        old = flist_bbcode_old_to_html(NULL, NULL, message, TRUE);
+        if(!diff_check(number, "strip", message, old, "", flist_bbcode_strip(message))) differences++;
+        checks++;
+
+        g_free(message);
+    }
+
+    printf("seed %d: %u messages, %u conversions, %u differences\n", seed, count, checks, differences);
+    g_rand_free(rand);
+    g_string_free(fetched, TRUE);
+    return differences ? 1 : 0;
+}
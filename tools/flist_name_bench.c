@@ -0,0 +1,144 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "f-list.h"
+
+#include <stdio.h>
+
+/* Times flist_str_hash and flist_str_equal, which back every table keyed */
+/* by character name, against what they replaced: a g_utf8_strdown copy */
+/* hashed with g_str_hash, and purple_utf8_strcasecmp. It also checks that */
+/* both hashes agree on every name, as tables depend on that. The names */
+/* look like F-List character names; some can be given a non-ASCII */
+/* letter, to time the fallback path too. */
+/* Like flist-replay, it links against tools/purple_stub.c, whose */
+/* purple_utf8_strcasecmp folds and collates the way libpurple's does. */
+
+static gint count = 20000;
+static gint rounds = 50;
+static gint unicode = 0;
+
+static GOptionEntry options[] = {
+    { "names", 'n', 0, G_OPTION_ARG_INT, &count, "Number of names (default 20000)", "N" },
+    { "rounds", 'r', 0, G_OPTION_ARG_INT, &rounds, "Times over every name (default 50)", "N" },
+    { "unicode", 'u', 0, G_OPTION_ARG_INT, &unicode, "Percent of names with a non-ASCII letter (default 0)", "PERCENT" },
+    { NULL }
+};
+
+static guint old_hash(const gchar *name) {
+    gchar *lower = g_utf8_strdown(name, -1);
+    guint ret = g_str_hash(lower);
+    g_free(lower);
+    return ret;
+}
+
+static gboolean old_equal(const gchar *name1, const gchar *name2) {
+    return purple_utf8_strcasecmp(name1, name2) == 0;
+}
+
+static gdouble bench_ns(gint64 start) {
+    return (gdouble) (g_get_monotonic_time() - start) * 1000.0 / ((gdouble) count * rounds);
+}
+
+int main(int argc, char *argv[]) {
+    GOptionContext *context;
+    GError *err = NULL;
+    gchar **names, **other_case;
+    guint sink = 0, mismatches = 0;
+    gint64 start;
+    gdouble old_ns, new_ns;
+    gint i, round;
+
+    context = g_option_context_new("- time the name hash and compare against the ones they replaced");
+    g_option_context_add_main_entries(context, options, NULL);
+    if(!g_option_context_parse(context, &argc, &argv, &err) || argc != 1 || count < 2 || rounds < 1) {
+        fprintf(stderr, "%s", err ? err->message : g_option_context_get_help(context, TRUE, NULL));
+        return 1;
+    }
+    g_option_context_free(context);
+
+    names = g_new(gchar *, count);
+    other_case = g_new(gchar *, count);
+    for(i = 0; i < count; i++) {
+        /* spread the non-ASCII names evenly */
+        gboolean wide = (i * unicode) / 100 != ((i + 1) * unicode) / 100;
+        names[i] = g_strdup_printf("%s Character %d", wide ? "S\xc3\xb6me" : "Some", i);
+        other_case[i] = g_utf8_strup(names[i], -1);
+    }
+
+    for(i = 0; i < count; i++) {
+        if(old_hash(names[i]) != flist_str_hash(names[i])) mismatches++;
+        if(flist_str_hash(names[i]) != flist_str_hash(other_case[i])) mismatches++;
+        if(!flist_str_equal(names[i], other_case[i])) mismatches++;
+    }
+    if(mismatches) {
+        printf("%u names hash or compare differently\n", mismatches);
+        return 1;
+    }
+    printf("%d names (%d%% non-ASCII), %d rounds\n", count, unicode, rounds);
+
+    start = g_get_monotonic_time();
+    for(round = 0; round < rounds; round++) {
+        for(i = 0; i < count; i++) sink += old_hash(names[i]);
+    }
+    old_ns = bench_ns(start);
+    start = g_get_monotonic_time();
+    for(round = 0; round < rounds; round++) {
+        for(i = 0; i < count; i++) sink += flist_str_hash(names[i]);
+    }
+    new_ns = bench_ns(start);
+    printf("hash:             %7.1f ns with g_utf8_strdown + g_str_hash, %7.1f ns with flist_str_hash\n", old_ns, new_ns);
+
+    start = g_get_monotonic_time();
+    for(round = 0; round < rounds; round++) {
+        for(i = 0; i < count; i++) sink += old_equal(names[i], other_case[i]);
+    }
+    old_ns = bench_ns(start);
+    start = g_get_monotonic_time();
+    for(round = 0; round < rounds; round++) {
+        for(i = 0; i < count; i++) sink += flist_str_equal(names[i], other_case[i]);
+    }
+    new_ns = bench_ns(start);
+    printf("equal, same name: %7.1f ns with purple_utf8_strcasecmp,    %7.1f ns with flist_str_equal\n", old_ns, new_ns);
+
+    /* neighbours differ only in the number at the end */
+    start = g_get_monotonic_time();
+    for(round = 0; round < rounds; round++) {
+        for(i = 0; i < count; i++) sink += old_equal(names[i], names[(i + 1) % count]);
+    }
+    old_ns = bench_ns(start);
+    start = g_get_monotonic_time();
+    for(round = 0; round < rounds; round++) {
+        for(i = 0; i < count; i++) sink += flist_str_equal(names[i], names[(i + 1) % count]);
+    }
+    new_ns = bench_ns(start);
+    printf("equal, different: %7.1f ns with purple_utf8_strcasecmp,    %7.1f ns with flist_str_equal\n", old_ns, new_ns);
+
+    /* keeps the loops from being optimized away */
+    if(sink == 1) printf("\n");
+
+    for(i = 0; i < count; i++) {
+        g_free(names[i]);
+        g_free(other_case[i]);
+    }
+    g_free(names);
+    g_free(other_case);
+    return 0;
+}
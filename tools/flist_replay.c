@@ -0,0 +1,361 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "purple_stub.h"
+
+#include <fcntl.h>
+#include <signal.h>
+
+/* Plays a capture made with the "Capture Received Data To" account option */
+/* back through the plugin: the server end of a socket pair writes what was */
+/* received, read by read, and the plugin takes it from there through */
+/* flist_process, the framing, the JSON parsing and the callbacks, against */
+/* the libpurple stub. This way a change can be measured on real traffic. */
+
+#define REPLAY_ACCOUNT "replay:Replay"
+#define REPLAY_ACCEPT_LEN 28 /* base64 of a SHA-1 digest */
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+typedef struct ReplayCapture_ ReplayCapture;
+
+struct ReplayCapture_ {
+    GString *data; /* everything that was received, in order */
+    GArray *reads; /* how much each recv() returned */
+    gboolean handshake; /* the capture starts with the server's HTTP response */
+    gboolean rfc6455;
+    gboolean deflate;
+    gsize accept_offset; /* where the Sec-WebSocket-Accept value starts */
+};
+
+gboolean purple_init_plugin(PurplePlugin *plugin);
+
+static gint runs = 1;
+static gint budget = 0;
+static gboolean verbose = FALSE;
+
+static GOptionEntry options[] = {
+    { "runs", 'n', 0, G_OPTION_ARG_INT, &runs, "Replay the capture this many times", "N" },
+    { "budget", 'b', 0, G_OPTION_ARG_INT, &budget, "Receive budget in KiB per input event", "KIB" },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print the plugin's debug output", NULL },
+    { NULL }
+};
+
+/* Every allocation goes through these, whether it is made by the plugin, */
+/* GLib or json-glib. glibc lets a program replace malloc this way. */
+static guint64 allocations;
+
+#ifdef __GLIBC__
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+/* A capture is a header line, "seconds.microseconds length", followed by */
+/* that many bytes, for each recv(). We only need the bytes. */
+static gboolean replay_load(ReplayCapture *capture, const gchar *path) {
+    gchar *contents;
+    gsize len;
+    const gchar *cur, *end;
+    GError *err = NULL;
+
+    if(!g_file_get_contents(path, &contents, &len, &err)) {
+        fprintf(stderr, "%s\n", err->message);
+        g_error_free(err);
+        return FALSE;
+    }
+
+    capture->data = g_string_sized_new(len);
+    capture->reads = g_array_new(FALSE, FALSE, sizeof(gsize));
+    for(cur = contents, end = contents + len; cur < end; ) {
+        const gchar *newline = memchr(cur, '\n', (gsize) (end - cur));
+        const gchar *space = newline ? memchr(cur, ' ', (gsize) (newline - cur)) : NULL;
+        gchar *tail;
+        gsize read_len;
+
+        if(!space) break;
+        read_len = (gsize) g_ascii_strtoull(space + 1, &tail, 10);
+        if(tail != newline || read_len > (gsize) (end - newline - 1)) break;
+        g_string_append_len(capture->data, newline + 1, (gssize) read_len);
+        g_array_append_val(capture->reads, read_len);
+        cur = newline + 1 + read_len;
+    }
+    g_free(contents);
+
+    if(cur < end) {
+        fprintf(stderr, "%s: record %u is damaged.\n", path, capture->reads->len + 1);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* The framing is decided by the handshake at the start of the capture. */
+static void replay_detect(ReplayCapture *capture) {
+    const gchar *data = capture->data->str;
+    const gchar *end = g_strstr_len(data, (gssize) capture->data->len, "\r\n\r\n");
+    const gchar *line, *next;
+
+    if(strncmp(data, "HTTP/", 5) || !end) return;
+    capture->handshake = TRUE;
+
+    for(line = data; line < end; line = next + 2) {
+        next = g_strstr_len(line, (gssize) (end + 2 - line), "\r\n");
+        if(!g_ascii_strncasecmp(line, "Sec-WebSocket-Accept:", 21)) {
+            const gchar *value = line + 21;
+            while(*value == ' ') value++;
+            if(next - value >= REPLAY_ACCEPT_LEN) {
+                capture->rfc6455 = TRUE;
+                capture->accept_offset = (gsize) (value - data);
+            }
+        } else if(!g_ascii_strncasecmp(line, "Sec-WebSocket-Extensions:", 25)
+                && g_strstr_len(line, (gssize) (next - line), "permessage-deflate")) {
+            capture->deflate = TRUE;
+        }
+    }
+}
+
+/* reads whatever the plugin sent, and keeps it if we want to look at it */
+static void replay_drain(int fd, GString *sent) {
+    gchar buf[16384];
+    gssize len;
+
+    while((len = read(fd, buf, sizeof(buf))) > 0) {
+        if(sent) g_string_append_len(sent, buf, len);
+    }
+}
+
+/* lets the plugin handle everything that is waiting for it */
+static gboolean replay_pump(int fd, GString *sent) {
+    do {
+        replay_drain(fd, sent);
+        if(purple_stub_error()) return FALSE;
+    } while(purple_stub_dispatch(0) > 0);
+    return TRUE;
+}
+
+/* The server's accept key answers the random key the plugin sent, so we */
+/* put the answer to this connection's key into the recorded response. */
+static gboolean replay_accept(ReplayCapture *capture, int fd) {
+    GString *request = g_string_new(NULL);
+    GChecksum *checksum;
+    guint8 digest[20];
+    gsize digest_len = sizeof(digest);
+    const gchar *key;
+    gchar *key_end, *accept;
+
+    while(!strstr(request->str, "\r\n\r\n")) {
+        if(!replay_pump(fd, request) || purple_stub_dispatch(100) == 0) {
+            g_string_free(request, TRUE);
+            return FALSE;
+        }
+    }
+    key = strstr(request->str, "Sec-WebSocket-Key: ");
+    if(!key) {
+        g_string_free(request, TRUE);
+        return FALSE;
+    }
+    key += 19;
+    key_end = strstr(key, "\r\n");
+    *key_end = '\0';
+
+    checksum = g_checksum_new(G_CHECKSUM_SHA1);
+    g_checksum_update(checksum, (const guchar *) key, -1);
+    g_checksum_update(checksum, (const guchar *) WEBSOCKET_GUID, -1);
+    g_checksum_get_digest(checksum, digest, &digest_len);
+    g_checksum_free(checksum);
+    accept = g_base64_encode(digest, digest_len);
+    memcpy(capture->data->str + capture->accept_offset, accept, REPLAY_ACCEPT_LEN);
+
+    g_free(accept);
+    g_string_free(request, TRUE);
+    return TRUE;
+}
+
+static gboolean replay_write(int fd, const gchar *data, gsize len) {
+    while(len > 0) {
+        gssize written = write(fd, data, len);
+        if(written > 0) {
+            data += written;
+            len -= (gsize) written;
+            continue;
+        }
+        if(written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return FALSE;
+        /* the socket is full, so the plugin has to read some of it first */
+        if(!replay_pump(fd, NULL)) return FALSE;
+    }
+    return TRUE;
+}
+
+static void replay_print_stats(FListAccount *fla) {
+    GString *str = g_string_new(NULL);
+    gchar **lines, **line;
+
+    flist_connection_stats(fla, str);
+    flist_callback_stats(fla, str);
+    flist_characters_stats(fla, str);
+    lines = g_strsplit(str->str, "<br>", -1);
+    for(line = lines; *line; line++) {
+        if(**line) printf("  %s\n", *line);
+    }
+    g_strfreev(lines);
+    g_string_free(str, TRUE);
+
+    printf("  Handed to libpurple: %" G_GUINT64_FORMAT " chat messages, %" G_GUINT64_FORMAT " IMs, %"
+        G_GUINT64_FORMAT " status updates, %" G_GUINT64_FORMAT " channel joins, %" G_GUINT64_FORMAT " channel leaves\n",
+        purple_stub_stats.chat_messages, purple_stub_stats.im_messages, purple_stub_stats.user_status,
+        purple_stub_stats.chat_users_added, purple_stub_stats.chat_users_removed);
+}
+
+static gboolean replay_run(PurplePlugin *plugin, ReplayCapture *capture, guint run, gboolean last) {
+    PurplePluginProtocolInfo *prpl = PURPLE_PLUGIN_PROTOCOL_INFO(plugin);
+    PurpleAccount *pa;
+    PurpleConnection *pc;
+    FListAccount *fla;
+    const gchar *data;
+    guint64 allocations_start;
+    gint64 start;
+    gdouble seconds;
+    gboolean ok = TRUE;
+    int fds[2];
+    guint i;
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        return FALSE;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+    purple_stub_reset();
+    purple_stub_set_setting("use_rfc6455", capture->rfc6455 ? "1" : "0");
+    purple_stub_set_setting("use_websocket_handshake", capture->handshake && !capture->rfc6455 ? "1" : "0");
+    purple_stub_set_setting("websocket_compression", capture->deflate ? "1" : "0");
+    if(budget > 0) {
+        gchar *value = g_strdup_printf("%d", budget);
+        purple_stub_set_setting("recv_budget", value);
+        g_free(value);
+    }
+
+    pa = g_new0(PurpleAccount, 1);
+    pc = g_new0(PurpleConnection, 1);
+    pa->username = g_strdup(REPLAY_ACCOUNT);
+    pa->password = g_strdup("");
+    pa->protocol_id = g_strdup(FLIST_PLUGIN_ID);
+    pa->gc = pc;
+    pc->account = pa;
+    pc->prpl = plugin;
+    pc->state = PURPLE_CONNECTING;
+
+    prpl->login(pa);
+    fla = pc->proto_data;
+    flist_connected(fla, fds[0], NULL);
+    if(capture->rfc6455 && !replay_accept(capture, fds[1])) {
+        fprintf(stderr, "The plugin did not send a WebSocket handshake.\n");
+        ok = FALSE;
+    }
+
+    allocations_start = allocations;
+    start = g_get_monotonic_time();
+    for(i = 0, data = capture->data->str; ok && i < capture->reads->len; i++) {
+        gsize len = g_array_index(capture->reads, gsize, i);
+        ok = replay_write(fds[1], data, len) && replay_pump(fds[1], NULL);
+        data += len;
+    }
+    seconds = (gdouble) (g_get_monotonic_time() - start) / G_USEC_PER_SEC;
+
+    if(!ok) {
+        fprintf(stderr, "Run %u stopped: %s\n", run, purple_stub_error() ? purple_stub_error() : g_strerror(errno));
+    } else {
+        guint64 run_allocations = allocations - allocations_start;
+        printf("Run %u: %.3f s, %.0f frames/s, %.1f MiB/s, %.3f s in flist_process, %" G_GUINT64_FORMAT
+            " allocations (%.1f per frame)\n", run, seconds, fla->stat_frames_in / seconds,
+            fla->stat_bytes_in / seconds / (1024 * 1024), (gdouble) fla->stat_process_usec / G_USEC_PER_SEC,
+            run_allocations, fla->stat_frames_in ? (gdouble) run_allocations / fla->stat_frames_in : 0.0);
+        if(last) replay_print_stats(fla);
+    }
+
+    prpl->close(pc);
+    close(fds[1]);
+    g_free(pa->username);
+    g_free(pa->password);
+    g_free(pa->protocol_id);
+    g_free(pa->alias);
+    g_free(pa);
+    g_free(pc);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    GOptionContext *context;
+    GError *err = NULL;
+    ReplayCapture capture;
+    PurplePlugin plugin;
+    struct rusage usage;
+    gint run;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+
+    context = g_option_context_new("CAPTURE - replay received F-Chat data through the plugin");
+    g_option_context_add_main_entries(context, options, NULL);
+    if(!g_option_context_parse(context, &argc, &argv, &err) || argc != 2) {
+        fprintf(stderr, "%s", err ? err->message : g_option_context_get_help(context, TRUE, NULL));
+        return 1;
+    }
+    g_option_context_free(context);
+
+    memset(&capture, 0, sizeof(capture));
+    if(!replay_load(&capture, argv[1])) return 1;
+    replay_detect(&capture);
+    printf("%s: %" G_GSIZE_FORMAT " bytes in %u reads, %s framing%s\n", argv[1], capture.data->len, capture.reads->len,
+        capture.rfc6455 ? "RFC 6455" : (capture.handshake ? "hixie" : "plain"), capture.deflate ? ", compressed" : "");
+
+    signal(SIGPIPE, SIG_IGN);
+    purple_stub_init(verbose);
+    memset(&plugin, 0, sizeof(plugin));
+    purple_init_plugin(&plugin);
+
+    for(run = 1; run <= runs; run++) {
+        if(!replay_run(&plugin, &capture, (guint) run, run == runs)) return 1;
+    }
+
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+        printf("Peak resident memory: %ld KiB\n", (long) usage.ru_maxrss);
+    }
+
+    g_string_free(capture.data, TRUE);
+    g_array_free(capture.reads, TRUE);
+    return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "purple_stub.h"
+
+#include <signal.h>
+
+/* Logs the plugin in to flist-mock-server, the whole way: the ticket from */
+/* its ticket page, the connection, the handshake, the login burst, and */
+/* then the channels. Once it is in, it measures how long the flooded */
+/* messages take from the server's send() to serv_got_chat_in, which the */
+/* server makes possible by putting its send time in each of them. */
+
+#define MOCK_DEFAULT_CHANNEL "Mock Channel"
+
+gboolean purple_init_plugin(PurplePlugin *plugin);
+
+static gchar *host = NULL;
+static gint port = FLIST_PORT;
+static gint ticket_port = 9723;
+static gchar *account = NULL;
+static gchar **channels = NULL;
+static gint seconds = 30;
+static gdouble say_rate = 0;
+static gboolean rfc6455 = FALSE;
+static gboolean handshake = FALSE;
+static gint budget = 0;
+static gboolean verbose = FALSE;
+
+static GOptionEntry options[] = {
+    { "host", 'H', 0, G_OPTION_ARG_STRING, &host, "Address of the mock server (default 127.0.0.1)", "HOST" },
+    { "port", 'p', 0, G_OPTION_ARG_INT, &port, "Chat port", "PORT" },
+    { "ticket-port", 't', 0, G_OPTION_ARG_INT, &ticket_port, "Ticket page port", "PORT" },
+    { "account", 'a', 0, G_OPTION_ARG_STRING, &account, "Log in as this (default mock:Mock Tester)", "ACCOUNT:CHARACTER" },
+    { "channel", 'c', 0, G_OPTION_ARG_STRING_ARRAY, &channels, "Join this channel (more than once for more)", "NAME" },
+    { "seconds", 's', 0, G_OPTION_ARG_INT, &seconds, "Measure for this long after joining", "SECONDS" },
+    { "say", 'r', 0, G_OPTION_ARG_DOUBLE, &say_rate, "Send this many messages per second, and time the echoes", "RATE" },
+    { "rfc6455", 0, 0, G_OPTION_ARG_NONE, &rfc6455, "Use RFC 6455 framing", NULL },
+    { "handshake", 0, 0, G_OPTION_ARG_NONE, &handshake, "Use the old WebSocket handshake", NULL },
+    { "budget", 'b', 0, G_OPTION_ARG_INT, &budget, "Receive budget in KiB per input event", "KIB" },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print the plugin's debug output", NULL },
+    { NULL }
+};
+
+static GArray *deliveries; /* server send to serv_got_chat_in, in microseconds */
+static GArray *round_trips; /* chat_send to the echo reaching serv_got_chat_in */
+static gboolean measuring = FALSE;
+
+static void mock_sample(GArray *samples, const gchar *mark) {
+    gint64 sent = g_ascii_strtoll(mark, NULL, 10);
+    gint64 latency = g_get_monotonic_time() - sent;
+    if(measuring && sent > 0) g_array_append_val(samples, latency);
+}
+
+static void mock_chat_hook(PurpleConnection *pc, int id, const char *who, const char *message) {
+    const gchar *mark;
+
+    /* our own message comes back here straight away, so only the echo counts */
+    if((mark = strstr(message, "echo: mock-rtt="))) {
+        mock_sample(round_trips, mark + 15);
+    } else if((mark = strstr(message, "mock-ts="))) {
+        mock_sample(deliveries, mark + 8);
+    }
+}
+
+static gint mock_compare(gconstpointer a, gconstpointer b) {
+    gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+    return x < y ? -1 : x > y;
+}
+
+static gdouble mock_percentile(GArray *samples, gdouble percent) {
+    guint i = (guint) (percent / 100 * (samples->len - 1) + 0.5);
+    return g_array_index(samples, gint64, i) / 1000.0;
+}
+
+static void mock_print_latency(const gchar *what, GArray *samples) {
+    gdouble total = 0;
+    guint i;
+
+    if(samples->len == 0) {
+        printf("%s: no messages\n", what);
+        return;
+    }
+    g_array_sort(samples, mock_compare);
+    for(i = 0; i < samples->len; i++) total += g_array_index(samples, gint64, i);
+    printf("%s: %u messages, in ms: mean %.3f, min %.3f, 50%% %.3f, 90%% %.3f, 99%% %.3f, 99.9%% %.3f, max %.3f\n",
+        what, samples->len, total / samples->len / 1000, mock_percentile(samples, 0), mock_percentile(samples, 50),
+        mock_percentile(samples, 90), mock_percentile(samples, 99), mock_percentile(samples, 99.9),
+        mock_percentile(samples, 100));
+}
+
+static void mock_print_stats(FListAccount *fla) {
+    GString *str = g_string_new(NULL);
+    gchar **lines, **line;
+
+    flist_connection_stats(fla, str);
+    flist_callback_stats(fla, str);
+    flist_characters_stats(fla, str);
+    lines = g_strsplit(str->str, "<br>", -1);
+    for(line = lines; *line; line++) {
+        if(**line) printf("  %s\n", *line);
+    }
+    g_strfreev(lines);
+    g_string_free(str, TRUE);
+}
+
+static void mock_join(PurpleConnection *pc) {
+    PurplePluginProtocolInfo *prpl = PURPLE_PLUGIN_PROTOCOL_INFO(pc->prpl);
+    gchar **channel;
+
+    for(channel = channels; *channel; channel++) {
+        GHashTable *components = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+        g_hash_table_insert(components, CHANNEL_COMPONENTS_NAME, g_strdup(*channel));
+        prpl->join_chat(pc, components);
+        g_hash_table_destroy(components);
+    }
+}
+
+static void mock_say(PurpleConnection *pc) {
+    PurplePluginProtocolInfo *prpl = PURPLE_PLUGIN_PROTOCOL_INFO(pc->prpl);
+    PurpleConversation *convo;
+    gchar *message;
+
+    convo = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channels[0], purple_connection_get_account(pc));
+    if(!convo) return; /* not joined yet */
+    message = g_strdup_printf("mock-rtt=%" G_GINT64_FORMAT, g_get_monotonic_time());
+    prpl->chat_send(pc, purple_conv_chat_get_id(PURPLE_CONV_CHAT(convo)), message, 0);
+    g_free(message);
+}
+
+int main(int argc, char *argv[]) {
+    GOptionContext *context;
+    GError *err = NULL;
+    PurplePlugin plugin;
+    PurplePluginProtocolInfo *prpl;
+    PurpleAccount *pa;
+    PurpleConnection *pc;
+    FListAccount *fla;
+    struct rusage usage;
+    gchar *value;
+    gint64 start, joined = 0, end = 0, next_say = 0;
+    guint64 frames_start = 0, bytes_start = 0, process_start = 0;
+    gdouble elapsed;
+
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+
+    context = g_option_context_new("- load the plugin from flist-mock-server and time the messages");
+    g_option_context_add_main_entries(context, options, NULL);
+    if(!g_option_context_parse(context, &argc, &argv, &err) || argc != 1) {
+        fprintf(stderr, "%s", err ? err->message : g_option_context_get_help(context, TRUE, NULL));
+        return 1;
+    }
+    g_option_context_free(context);
+    if(!host) host = g_strdup("127.0.0.1");
+    if(!account) account = g_strdup("mock:Mock Tester");
+    if(!channels) {
+        channels = g_new0(gchar *, 2);
+        channels[0] = g_strdup(MOCK_DEFAULT_CHANNEL);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    deliveries = g_array_new(FALSE, FALSE, sizeof(gint64));
+    round_trips = g_array_new(FALSE, FALSE, sizeof(gint64));
+    purple_stub_init(verbose);
+    purple_stub_allow_host(host);
+    purple_stub_set_chat_hook(mock_chat_hook);
+    memset(&plugin, 0, sizeof(plugin));
+    purple_init_plugin(&plugin);
+    prpl = PURPLE_PLUGIN_PROTOCOL_INFO(&plugin);
+
+    purple_stub_set_setting("server_address", host);
+    value = g_strdup_printf("%d", port);
+    purple_stub_set_setting("server_port", value);
+    g_free(value);
+    value = g_strdup_printf("http://%s:%d/json/getApiTicket.php", host, ticket_port);
+    purple_stub_set_setting("ticket_url", value);
+    g_free(value);
+    purple_stub_set_setting("use_rfc6455", rfc6455 ? "1" : "0");
+    purple_stub_set_setting("use_websocket_handshake", handshake ? "1" : "0");
+    if(budget > 0) {
+        value = g_strdup_printf("%d", budget);
+        purple_stub_set_setting("recv_budget", value);
+        g_free(value);
+    }
+
+    pa = g_new0(PurpleAccount, 1);
+    pc = g_new0(PurpleConnection, 1);
+    pa->username = g_strdup(account);
+    pa->password = g_strdup("");
+    pa->protocol_id = g_strdup(FLIST_PLUGIN_ID);
+    pa->gc = pc;
+    pc->account = pa;
+    pc->prpl = &plugin;
+    pc->state = PURPLE_CONNECTING;
+
+    start = g_get_monotonic_time();
+    prpl->login(pa);
+    fla = pc->proto_data;
+
+    while(!end || g_get_monotonic_time() < end) {
+        gint64 now;
+
+        purple_stub_dispatch(10);
+        if(purple_stub_error()) {
+            fprintf(stderr, "Stopped: %s\n", purple_stub_error());
+            return 1;
+        }
+        now = g_get_monotonic_time();
+        if(!joined && fla->online) {
+            joined = now;
+            printf("Logged in after %.3f s: %" G_GUINT64_FORMAT " frames, %.1f MiB, %.3f s in flist_process\n",
+                (gdouble) (joined - start) / G_USEC_PER_SEC, fla->stat_frames_in,
+                fla->stat_bytes_in / (1024.0 * 1024), (gdouble) fla->stat_process_usec / G_USEC_PER_SEC);
+            mock_join(pc);
+        } else if(joined && !end && purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, channels[0], pa)) {
+            /* the channel joins are done with, so the flood starts here */
+            measuring = TRUE;
+            end = now + (gint64) seconds * G_USEC_PER_SEC;
+            next_say = now;
+            frames_start = fla->stat_frames_in;
+            bytes_start = fla->stat_bytes_in;
+            process_start = fla->stat_process_usec;
+        }
+        while(end && say_rate > 0 && now >= next_say) {
+            mock_say(pc);
+            next_say += (gint64) (G_USEC_PER_SEC / say_rate);
+        }
+        if(!end && now - start > 60 * G_USEC_PER_SEC) {
+            fprintf(stderr, "%s after a minute; is flist-mock-server running?\n", joined ? "Not in the channel" : "Not logged in");
+            return 1;
+        }
+    }
+
+    elapsed = (gdouble) seconds;
+    printf("Measured for %.0f s: %.0f frames/s, %.1f MiB/s, %.1f%% of the time in flist_process\n", elapsed,
+        (fla->stat_frames_in - frames_start) / elapsed, (fla->stat_bytes_in - bytes_start) / elapsed / (1024 * 1024),
+        (gdouble) (fla->stat_process_usec - process_start) / (elapsed * G_USEC_PER_SEC) * 100);
+    mock_print_latency("Server to serv_got_chat_in", deliveries);
+    if(say_rate > 0) mock_print_latency("Round trip", round_trips);
+    mock_print_stats(fla);
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+        printf("Peak resident memory: %ld KiB\n", (long) usage.ru_maxrss);
+    }
+
+    prpl->close(pc);
+    g_free(pa->username);
+    g_free(pa->password);
+    g_free(pa->protocol_id);
+    g_free(pa->alias);
+    g_free(pa);
+    g_free(pc);
+    g_array_free(deliveries, TRUE);
+    g_array_free(round_trips, TRUE);
+    return 0;
+}
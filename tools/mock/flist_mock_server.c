@@ -0,0 +1,975 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* A stand-in for the F-Chat server and the ticket page, to load the plugin */
+/* with more traffic than we would want to ask of the real server. It */
+/* answers IDN, PIN, JCH, LCH, MSG and PRI, sends a synthetic LIS of as many */
+/* characters as asked for, and keeps NLN/FLN churn and channel floods going */
+/* at a fixed rate. Every flooded message carries "mock-ts=" followed by */
+/* the CLOCK_MONOTONIC time it was sent at in microseconds, which is what */
+/* g_get_monotonic_time() returns, so a client on the same machine can tell */
+/* how long the message took to reach serv_got_chat_in. */
+/* */
+/* It only needs libc, so it can run on a machine without the plugin's */
+/* dependencies. It speaks all three framings the plugin does: the plain */
+/* one (WSH first), the old hixie handshake and RFC 6455, without */
+/* compression. */
+
+#define MOCK_CHAT_PORT 9722
+#define MOCK_TICKET_PORT 9723
+#define MOCK_LIS_CHUNK 100 /* characters per LIS, like the real server */
+#define MOCK_MAX_BACKLOG (32 * 1024 * 1024) /* stop generating for a client this far behind */
+#define MOCK_MAX_CHANNELS 64
+#define MOCK_NAME_LEN 32
+#define MOCK_READ_CHUNK 65536
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+typedef struct MockBuffer_ MockBuffer;
+typedef struct MockChannel_ MockChannel;
+typedef struct MockClient_ MockClient;
+
+typedef enum {
+    MOCK_HTTP, /* a ticket request */
+    MOCK_NEW, /* a chat connection we haven't seen anything on yet */
+    MOCK_PLAIN, /* \x00 ... \xff frames, with or without the hixie handshake */
+    MOCK_RFC6455
+} MockFraming;
+
+struct MockBuffer_ {
+    char *data;
+    size_t start, len, size; /* the contents are data[start, start + len) */
+};
+
+struct MockChannel_ {
+    char name[256]; /* as it came in, still JSON escaped */
+    unsigned first_user; /* the members are a run of the world's characters */
+    uint64_t sent;
+    int64_t started;
+};
+
+struct MockClient_ {
+    int fd;
+    MockFraming framing;
+    int closing; /* close once everything is written */
+    MockBuffer in, out;
+    char character[256]; /* still JSON escaped */
+    int identified; /* has had its LIS, so it gets churn */
+    MockChannel channels[MOCK_MAX_CHANNELS];
+    unsigned channel_count;
+
+    uint64_t frames_in, frames_out, bytes_out, pings_answered, dropped;
+    int64_t connected;
+};
+
+/* the characters we know, and which of them are online */
+static unsigned world_size;
+static unsigned *online, *offline;
+static unsigned online_count, offline_count;
+static unsigned char *world_status;
+
+static MockClient **clients;
+static unsigned client_count;
+
+static unsigned opt_characters = 1000;
+static unsigned opt_channel_users = 100;
+static double opt_flood_rate = 0;
+static double opt_churn_rate = 0;
+static unsigned opt_message_length = 80;
+static unsigned opt_ping_interval = 30;
+static int opt_verbose = 0;
+
+static uint64_t churn_sent;
+static int64_t churn_started;
+static uint64_t tickets_issued;
+static volatile sig_atomic_t stopping;
+
+static const char *genders[] = { "Male", "Female", "Transgender", "Herm", "Shemale", "Male-Herm", "Cunt-boy", "None" };
+static const char *statuses[] = { "online", "looking", "away", "busy", "dnd" };
+static const char *syllables[] = { "Ar", "Bel", "Cor", "Dra", "El", "Fen", "Gal", "Hal", "Ir", "Jen",
+    "Kal", "Lor", "Mar", "Nyx", "Or", "Pa", "Quin", "Ren", "Sa", "Tor", "Ul", "Vey", "Wyn", "Zel" };
+static const char *status_messages[] = { "", "", "", "Looking for [b]long-term[/b] roleplay.",
+    "Away for a bit.", "[i]Busy[/i], ask first.", "See my profile for [url=http://localhost/]limits[/url]." };
+static const char *filler = "Flood message from the [b]mock[/b] server, with [i]some[/i] "
+    "[color=red]BBCode[/color] and a [url=http://localhost/]link[/url] to parse. ";
+
+static int64_t mock_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* xorshift64*, so a seed gives the same world and traffic every time */
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t mock_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t) ((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void *mock_alloc(void *ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if(!ptr) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static char *buffer_reserve(MockBuffer *buf, size_t len) {
+    if(buf->start > 0 && buf->start + buf->len + len > buf->size) {
+        memmove(buf->data, buf->data + buf->start, buf->len);
+        buf->start = 0;
+    }
+    if(buf->start + buf->len + len > buf->size) {
+        size_t size = buf->size ? buf->size : 4096;
+        while(size < buf->len + len) size *= 2;
+        buf->data = mock_alloc(buf->data, size);
+        buf->size = size;
+    }
+    return buf->data + buf->start + buf->len;
+}
+
+static void buffer_append(MockBuffer *buf, const void *data, size_t len) {
+    memcpy(buffer_reserve(buf, len), data, len);
+    buf->len += len;
+}
+
+static void buffer_append_str(MockBuffer *buf, const char *str) {
+    buffer_append(buf, str, strlen(str));
+}
+
+static void buffer_printf(MockBuffer *buf, const char *format, ...) {
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    va_start(args, format);
+    vsnprintf(buffer_reserve(buf, (size_t) len + 1), (size_t) len + 1, format, args);
+    va_end(args);
+    buf->len += (size_t) len;
+}
+
+static void buffer_consume(MockBuffer *buf, size_t len) {
+    buf->start += len;
+    buf->len -= len;
+    if(buf->len == 0) buf->start = 0;
+}
+
+static void buffer_free(MockBuffer *buf) {
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/* Characters are named from their number, so the world is just a status */
+/* per character. The names stay well under F-List's limit of 20. */
+static void mock_name(unsigned id, char *name) {
+    unsigned count = sizeof(syllables) / sizeof(syllables[0]);
+    snprintf(name, MOCK_NAME_LEN, "%s%s %u", syllables[id % count], syllables[(id / count) % count], id);
+}
+
+static void world_init(void) {
+    unsigned i;
+
+    /* a few characters start offline, so churn can bring them online */
+    world_size = opt_characters + opt_characters / 10 + 16;
+    online = mock_alloc(NULL, sizeof(unsigned) * world_size);
+    offline = mock_alloc(NULL, sizeof(unsigned) * world_size);
+    world_status = mock_alloc(NULL, world_size);
+    for(i = 0; i < world_size; i++) {
+        world_status[i] = (unsigned char) (mock_random() % 5 == 0 ? 1 + mock_random() % 4 : 0);
+        if(i < opt_characters) online[online_count++] = i;
+        else offline[offline_count++] = i;
+    }
+}
+
+/* SHA-1 (RFC 3174), only needed for the RFC 6455 accept key */
+static uint32_t sha1_rol(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1_block(uint32_t *h, const unsigned char *block) {
+    uint32_t w[80], a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f, k, t;
+    int i;
+
+    for(i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16
+            | (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for(i = 16; i < 80; i++) w[i] = sha1_rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    for(i = 0; i < 80; i++) {
+        if(i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+        else if(i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+        else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+        t = sha1_rol(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = sha1_rol(b, 30); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void sha1(const unsigned char *data, size_t len, unsigned char *digest) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    unsigned char block[64];
+    uint64_t bits = (uint64_t) len * 8;
+    size_t i, rest;
+
+    for(i = 0; i + 64 <= len; i += 64) sha1_block(h, data + i);
+    rest = len - i;
+    memset(block, 0, sizeof(block));
+    memcpy(block, data + i, rest);
+    block[rest] = 0x80;
+    if(rest >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    for(i = 0; i < 8; i++) block[63 - i] = (unsigned char) (bits >> (i * 8));
+    sha1_block(h, block);
+    for(i = 0; i < 20; i++) digest[i] = (unsigned char) (h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+static void base64(const unsigned char *data, size_t len, char *out) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+
+    for(i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t) data[i] << 16 | (i + 1 < len ? (uint32_t) data[i + 1] << 8 : 0) | (i + 2 < len ? data[i + 2] : 0);
+        *out++ = table[(v >> 18) & 63];
+        *out++ = table[(v >> 12) & 63];
+        *out++ = i + 1 < len ? table[(v >> 6) & 63] : '=';
+        *out++ = i + 2 < len ? table[v & 63] : '=';
+    }
+    *out = '\0';
+}
+
+/* finds a header in an HTTP request, case insensitively; the value isn't */
+/* terminated, so its length is returned in len */
+static const char *http_header(const char *headers, const char *end, const char *name, size_t *len) {
+    size_t name_len = strlen(name);
+    const char *line = strstr(headers, "\r\n");
+
+    while(line && line + 2 < end) {
+        const char *next;
+        line += 2;
+        next = strstr(line, "\r\n");
+        if(!next || next > end) break;
+        if((size_t) (next - line) > name_len && line[name_len] == ':' && !strncasecmp(line, name, name_len)) {
+            const char *value = line + name_len + 1;
+            while(*value == ' ' || *value == '\t') value++;
+            *len = (size_t) (next - value);
+            return value;
+        }
+        line = next;
+    }
+    return NULL;
+}
+
+/* Takes a string member straight out of a flat JSON object, still escaped, */
+/* since all we ever do with one is compare it or send it back. */
+static int json_member(const char *json, size_t json_len, const char *key, char *value, size_t size) {
+    char pattern[64];
+    const char *end = json + json_len, *cur, *start;
+    size_t len;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    len = strlen(pattern);
+    for(cur = json; cur + len <= end; cur++) {
+        if(memcmp(cur, pattern, len)) continue;
+        cur += len;
+        while(cur < end && (*cur == ' ' || *cur == ':')) cur++;
+        if(cur >= end || *cur != '"') return 0;
+        start = ++cur;
+        while(cur < end && *cur != '"') cur += *cur == '\\' ? 2 : 1;
+        if(cur >= end || (size_t) (cur - start) >= size) return 0;
+        memcpy(value, start, (size_t) (cur - start));
+        value[cur - start] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+static MockClient *client_new(int fd, MockFraming framing) {
+    MockClient *client = mock_alloc(NULL, sizeof(MockClient));
+    int one = 1;
+
+    memset(client, 0, sizeof(*client));
+    client->fd = fd;
+    client->framing = framing;
+    client->connected = mock_now();
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    clients = mock_alloc(clients, sizeof(MockClient *) * (client_count + 1));
+    clients[client_count++] = client;
+    return client;
+}
+
+static void client_free(MockClient *client) {
+    unsigned i;
+
+    if(client->framing != MOCK_HTTP) {
+        double seconds = (double) (mock_now() - client->connected) / 1000000;
+        printf("%s disconnected after %.1f s: %llu frames in, %llu frames out (%.1f MiB), %llu pings answered, %llu events dropped\n",
+            client->character[0] ? client->character : "A client", seconds,
+            (unsigned long long) client->frames_in, (unsigned long long) client->frames_out,
+            (double) client->bytes_out / (1024 * 1024), (unsigned long long) client->pings_answered,
+            (unsigned long long) client->dropped);
+    }
+    close(client->fd);
+    buffer_free(&client->in);
+    buffer_free(&client->out);
+    for(i = 0; i < client_count; i++) {
+        if(clients[i] == client) {
+            clients[i] = clients[--client_count];
+            break;
+        }
+    }
+    free(client);
+}
+
+/* Frames are built in place: room for the longest header is left in front */
+/* of the payload, and the header is written once we know the length. */
+#define MOCK_HEADROOM 10
+
+static MockBuffer frame;
+
+static void frame_begin(const char *code) {
+    frame.start = 0;
+    frame.len = MOCK_HEADROOM;
+    buffer_reserve(&frame, 0);
+    buffer_append_str(&frame, code);
+}
+
+static void frame_send(MockClient *client) {
+    size_t payload_len = frame.len - MOCK_HEADROOM;
+    unsigned char *payload = (unsigned char *) frame.data + MOCK_HEADROOM;
+    unsigned char *header;
+
+    if(client->framing == MOCK_RFC6455) {
+        if(payload_len < 126) {
+            header = payload - 2;
+            header[1] = (unsigned char) payload_len;
+        } else if(payload_len < 65536) {
+            header = payload - 4;
+            header[1] = 126;
+            header[2] = (unsigned char) (payload_len >> 8);
+            header[3] = (unsigned char) payload_len;
+        } else {
+            int i;
+            header = payload - 10;
+            header[1] = 127;
+            for(i = 0; i < 8; i++) header[2 + i] = (unsigned char) ((uint64_t) payload_len >> (56 - i * 8));
+        }
+        header[0] = 0x81; /* a whole text message */
+        buffer_append(&client->out, header, (size_t) (payload + payload_len - header));
+    } else {
+        buffer_append(&client->out, "\x00", 1);
+        buffer_append(&client->out, payload, payload_len);
+        buffer_append(&client->out, "\xff", 1);
+    }
+    client->frames_out++;
+}
+
+static void send_simple(MockClient *client, const char *code, const char *format, ...) {
+    va_list args;
+    int len;
+
+    frame_begin(code);
+    if(format) {
+        buffer_append_str(&frame, " ");
+        va_start(args, format);
+        len = vsnprintf(NULL, 0, format, args);
+        va_end(args);
+        va_start(args, format);
+        vsnprintf(buffer_reserve(&frame, (size_t) len + 1), (size_t) len + 1, format, args);
+        va_end(args);
+        frame.len += (size_t) len;
+    }
+    frame_send(client);
+}
+
+static void send_login(MockClient *client) {
+    char name[MOCK_NAME_LEN];
+    unsigned i;
+
+    send_simple(client, "IDN", "{\"character\":\"%s\"}", client->character);
+    send_simple(client, "VAR", "{\"variable\":\"chat_max\",\"value\":4096}");
+    send_simple(client, "VAR", "{\"variable\":\"priv_max\",\"value\":50000}");
+    send_simple(client, "HLO", "{\"message\":\"Welcome to the mock F-Chat server.\"}");
+    send_simple(client, "CON", "{\"count\":%u}", online_count);
+    send_simple(client, "FRL", "{\"characters\":[]}");
+    send_simple(client, "IGN", "{\"action\":\"init\",\"characters\":[]}");
+    send_simple(client, "ADL", "{\"ops\":[\"Mock Admin\"]}");
+
+    for(i = 0; i < online_count; i++) {
+        unsigned id = online[i];
+        if(i % MOCK_LIS_CHUNK == 0) {
+            if(i > 0) {
+                buffer_append_str(&frame, "]}");
+                frame_send(client);
+            }
+            frame_begin("LIS {\"characters\":[");
+        } else {
+            buffer_append_str(&frame, ",");
+        }
+        mock_name(id, name);
+        buffer_printf(&frame, "[\"%s\",\"%s\",\"%s\",\"%s\"]", name, genders[id % 8], statuses[world_status[id]],
+            status_messages[id % (sizeof(status_messages) / sizeof(status_messages[0]))]);
+    }
+    if(online_count > 0) {
+        buffer_append_str(&frame, "]}");
+        frame_send(client);
+    }
+
+    /* our own NLN ends the login, as it does on the real server */
+    send_simple(client, "NLN", "{\"identity\":\"%s\",\"gender\":\"None\",\"status\":\"online\"}", client->character);
+    client->identified = 1;
+}
+
+static MockChannel *channel_find(MockClient *client, const char *name) {
+    unsigned i;
+    for(i = 0; i < client->channel_count; i++) {
+        if(!strcmp(client->channels[i].name, name)) return &client->channels[i];
+    }
+    return NULL;
+}
+
+static unsigned channel_users(void) {
+    return opt_channel_users < world_size ? opt_channel_users : world_size;
+}
+
+static void channel_member(MockChannel *channel, unsigned n, char *name) {
+    mock_name((channel->first_user + n) % world_size, name);
+}
+
+static void send_join(MockClient *client, const char *name) {
+    MockChannel *channel = channel_find(client, name);
+    char member[MOCK_NAME_LEN];
+    unsigned hash = 5381, i, users = channel_users();
+    const char *cur;
+
+    if(!channel) {
+        if(client->channel_count == MOCK_MAX_CHANNELS) {
+            send_simple(client, "ERR", "{\"number\":-1,\"message\":\"The mock server can't join you to more channels.\"}");
+            return;
+        }
+        channel = &client->channels[client->channel_count++];
+        snprintf(channel->name, sizeof(channel->name), "%s", name);
+        for(cur = name; *cur; cur++) hash = hash * 33 + (unsigned char) *cur;
+        channel->first_user = hash % world_size;
+        channel->sent = 0;
+        channel->started = mock_now();
+    }
+
+    send_simple(client, "JCH", "{\"channel\":\"%s\",\"character\":{\"identity\":\"%s\"},\"title\":\"%s\"}",
+        name, client->character, name);
+
+    frame_begin("ICH {\"users\":[");
+    for(i = 0; i < users; i++) {
+        channel_member(channel, i, member);
+        buffer_printf(&frame, "{\"identity\":\"%s\"},", member);
+    }
+    buffer_printf(&frame, "{\"identity\":\"%s\"}],\"channel\":\"%s\",\"mode\":\"both\"}", client->character, name);
+    frame_send(client);
+
+    channel_member(channel, 0, member);
+    send_simple(client, "COL", "{\"channel\":\"%s\",\"oplist\":[\"%s\"]}", name, member);
+    send_simple(client, "CDS", "{\"channel\":\"%s\",\"description\":\"A [b]mock[/b] channel with %u users.\"}", name, users);
+}
+
+static void send_leave(MockClient *client, const char *name) {
+    MockChannel *channel = channel_find(client, name);
+
+    if(!channel) return;
+    send_simple(client, "LCH", "{\"channel\":\"%s\",\"character\":\"%s\"}", name, client->character);
+    *channel = client->channels[--client->channel_count];
+}
+
+static void send_flood(MockClient *client, MockChannel *channel, int64_t now) {
+    char member[MOCK_NAME_LEN];
+    size_t filler_len = strlen(filler), text_start;
+
+    channel_member(channel, mock_random() % channel_users(), member);
+    frame_begin("MSG {\"character\":\"");
+    buffer_append_str(&frame, member);
+    buffer_append_str(&frame, "\",\"message\":\"");
+    text_start = frame.len;
+    buffer_printf(&frame, "mock-ts=%lld #%llu ", (long long) now, (unsigned long long) channel->sent);
+    while(frame.len - text_start < opt_message_length) {
+        size_t len = opt_message_length - (frame.len - text_start);
+        buffer_append(&frame, filler, len < filler_len ? len : filler_len);
+    }
+    buffer_printf(&frame, "\",\"channel\":\"%s\"}", channel->name);
+    frame_send(client);
+}
+
+/* one character logs in or out, and everybody who is logged in hears it */
+static void send_churn(void) {
+    char name[MOCK_NAME_LEN];
+    unsigned i, id;
+    int logging_in = churn_sent % 2 ? offline_count > 0 : online_count == 0;
+
+    if(logging_in) {
+        i = mock_random() % offline_count;
+        id = offline[i];
+        offline[i] = offline[--offline_count];
+        online[online_count++] = id;
+    } else {
+        i = mock_random() % online_count;
+        id = online[i];
+        online[i] = online[--online_count];
+        offline[offline_count++] = id;
+    }
+    mock_name(id, name);
+
+    for(i = 0; i < client_count; i++) {
+        MockClient *client = clients[i];
+        if(!client->identified) continue;
+        if(client->out.len > MOCK_MAX_BACKLOG) {
+            client->dropped++;
+            continue;
+        }
+        if(logging_in) {
+            send_simple(client, "NLN", "{\"identity\":\"%s\",\"gender\":\"%s\",\"status\":\"online\"}", name, genders[id % 8]);
+        } else {
+            send_simple(client, "FLN", "{\"character\":\"%s\"}", name);
+        }
+    }
+    churn_sent++;
+}
+
+static void handle_command(MockClient *client, const char *data, size_t len) {
+    char channel[256], value[8192], member[MOCK_NAME_LEN];
+    const char *json = len > 4 ? data + 4 : "";
+    size_t json_len = len > 4 ? len - 4 : 0;
+    MockChannel *joined;
+
+    client->frames_in++;
+    if(opt_verbose) printf("<< %.*s\n", (int) (len > 200 ? 200 : len), data);
+    if(len < 3) return;
+
+    if(!memcmp(data, "WSH", 3)) {
+        send_simple(client, "WSH", NULL);
+    } else if(!memcmp(data, "IDN", 3)) {
+        /* any ticket will do; the ticket page hands out made up ones */
+        if(!json_member(json, json_len, "character", client->character, sizeof(client->character))) {
+            send_simple(client, "ERR", "{\"number\":-1,\"message\":\"No character given.\"}");
+            client->closing = 1;
+            return;
+        }
+        printf("%s logged in.\n", client->character);
+        send_login(client);
+    } else if(!memcmp(data, "PIN", 3)) {
+        /* the server pings and the client answers, never the other way */
+        client->pings_answered++;
+    } else if(!memcmp(data, "JCH", 3)) {
+        if(json_member(json, json_len, "channel", channel, sizeof(channel))) send_join(client, channel);
+    } else if(!memcmp(data, "LCH", 3)) {
+        if(json_member(json, json_len, "channel", channel, sizeof(channel))) send_leave(client, channel);
+    } else if(!memcmp(data, "MSG", 3)) {
+        /* somebody in the channel repeats it, so a round trip can be timed too */
+        if(!json_member(json, json_len, "channel", channel, sizeof(channel))) return;
+        if(!json_member(json, json_len, "message", value, sizeof(value))) return;
+        joined = channel_find(client, channel);
+        if(!joined) {
+            send_simple(client, "ERR", "{\"number\":28,\"message\":\"You are not in the requested channel.\"}");
+            return;
+        }
+        channel_member(joined, mock_random() % channel_users(), member);
+        send_simple(client, "MSG", "{\"character\":\"%s\",\"message\":\"echo: %s\",\"channel\":\"%s\"}", member, value, channel);
+    } else if(!memcmp(data, "PRI", 3)) {
+        if(!json_member(json, json_len, "recipient", channel, sizeof(channel))) return;
+        if(!json_member(json, json_len, "message", value, sizeof(value))) return;
+        send_simple(client, "PRI", "{\"character\":\"%s\",\"message\":\"echo: %s\"}", channel, value);
+    } else if(!memcmp(data, "CHA", 3)) {
+        send_simple(client, "CHA", "{\"channels\":[{\"name\":\"Mock Channel\",\"mode\":\"both\",\"characters\":%u}]}", channel_users());
+    } else if(!memcmp(data, "ORS", 3)) {
+        send_simple(client, "ORS", "{\"channels\":[]}");
+    }
+}
+
+/* The handshake decides the framing: a GET with Sec-WebSocket-Key is */
+/* RFC 6455, a GET with Sec-WebSocket-Key1 is hixie, and a frame is plain. */
+static int handle_handshake(MockClient *client) {
+    const char *data = client->in.data + client->in.start, *end, *key;
+    size_t key_len, header_len;
+    char accept_src[128], accept[32];
+    unsigned char digest[20];
+
+    if(client->in.len == 0) return 0;
+    if(data[0] == '\x00') {
+        client->framing = MOCK_PLAIN;
+        return 1;
+    }
+    if(client->in.len < 4) return 0;
+    if(memcmp(data, "GET ", 4)) {
+        client->closing = 1;
+        return 0;
+    }
+
+    buffer_reserve(&client->in, 1);
+    data = client->in.data + client->in.start;
+    ((char *) data)[client->in.len] = '\0';
+    end = strstr(data, "\r\n\r\n");
+    if(!end) return 0;
+    header_len = (size_t) (end - data) + 4;
+
+    key = http_header(data, end + 2, "Sec-WebSocket-Key", &key_len);
+    if(key && key_len < 64) {
+        snprintf(accept_src, sizeof(accept_src), "%.*s%s", (int) key_len, key, WEBSOCKET_GUID);
+        sha1((const unsigned char *) accept_src, strlen(accept_src), digest);
+        base64(digest, sizeof(digest), accept);
+        buffer_printf(&client->out, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+            "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+        buffer_consume(&client->in, header_len);
+        client->framing = MOCK_RFC6455;
+        return 1;
+    }
+
+    /* hixie: eight more bytes follow the headers, and we answer with */
+    /* sixteen; the plugin skips them without looking, so they are zero */
+    if(client->in.len < header_len + 8) return 0;
+    buffer_append_str(&client->out, "HTTP/1.1 101 WebSocket Protocol Handshake\r\nUpgrade: WebSocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Origin: http://www.f-list.net\r\n"
+        "Sec-WebSocket-Location: ws://localhost/\r\n\r\n");
+    buffer_append(&client->out, "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16);
+    buffer_consume(&client->in, header_len + 8);
+    client->framing = MOCK_PLAIN;
+    return 1;
+}
+
+/* returns 0 when there is no whole frame yet */
+static int handle_frame(MockClient *client) {
+    unsigned char *data = (unsigned char *) client->in.data + client->in.start;
+    size_t available = client->in.len, header_len = 2, payload_len, i;
+    unsigned char *end, *mask;
+
+    if(available == 0) return 0;
+
+    if(client->framing == MOCK_PLAIN) {
+        if(data[0] != 0x00) {
+            client->closing = 1;
+            return 0;
+        }
+        end = memchr(data, 0xff, available);
+        if(!end) return 0;
+        handle_command(client, (const char *) data + 1, (size_t) (end - data) - 1);
+        buffer_consume(&client->in, (size_t) (end - data) + 1);
+        return 1;
+    }
+
+    if(available < 2) return 0;
+    payload_len = data[1] & 0x7f;
+    if(payload_len == 126) {
+        header_len += 2;
+        if(available < header_len) return 0;
+        payload_len = (size_t) data[2] << 8 | data[3];
+    } else if(payload_len == 127) {
+        header_len += 8;
+        if(available < header_len) return 0;
+        for(payload_len = 0, i = 2; i < 10; i++) payload_len = payload_len << 8 | data[i];
+    }
+    if(!(data[1] & 0x80)) { /* clients have to mask what they send */
+        client->closing = 1;
+        return 0;
+    }
+    mask = data + header_len;
+    header_len += 4;
+    if(available < header_len || available - header_len < payload_len) return 0;
+    for(i = 0; i < payload_len; i++) data[header_len + i] ^= mask[i % 4];
+
+    switch(data[0] & 0x0f) {
+    case 0x1: /* the plugin never fragments, so a text frame is a command */
+        handle_command(client, (const char *) data + header_len, payload_len);
+        break;
+    case 0x8:
+        buffer_append(&client->out, "\x88\x00", 2);
+        client->closing = 1;
+        break;
+    case 0x9: {
+        unsigned char pong[2] = { 0x8a, 0 };
+        if(payload_len < 126) {
+            pong[1] = (unsigned char) payload_len;
+            buffer_append(&client->out, pong, 2);
+            buffer_append(&client->out, data + header_len, payload_len);
+        }
+        break;
+    }
+    }
+    buffer_consume(&client->in, header_len + payload_len);
+    return 1;
+}
+
+static void handle_http(MockClient *client) {
+    const char *data, *end, *length;
+    size_t length_len, body_len = 0, body_start;
+    char body[512];
+    int len;
+
+    buffer_reserve(&client->in, 1);
+    data = client->in.data + client->in.start;
+    ((char *) data)[client->in.len] = '\0';
+    end = strstr(data, "\r\n\r\n");
+    if(!end) return;
+    body_start = (size_t) (end - data) + 4;
+    length = http_header(data, end + 2, "Content-Length", &length_len);
+    if(length) body_len = strtoul(length, NULL, 10);
+    if(client->in.len < body_start + body_len) return;
+
+    if(opt_verbose) printf("<< %.*s\n", (int) (strchr(data, '\r') - data), data);
+    len = snprintf(body, sizeof(body), "{\"ticket\":\"mock-ticket-%llu\",\"error\":\"\",\"characters\":[],"
+        "\"default_character\":\"\",\"friends\":[],\"bookmarks\":[]}", (unsigned long long) ++tickets_issued);
+    buffer_printf(&client->out, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\n"
+        "Connection: close\r\n\r\n%s", len, body);
+    buffer_consume(&client->in, client->in.len);
+    client->closing = 1;
+}
+
+/* returns 0 once the client is gone */
+static int client_read(MockClient *client) {
+    ssize_t len;
+
+    for(;;) {
+        len = recv(client->fd, buffer_reserve(&client->in, MOCK_READ_CHUNK), MOCK_READ_CHUNK, 0);
+        if(len > 0) {
+            client->in.len += (size_t) len;
+            continue;
+        }
+        if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+        return 0;
+    }
+
+    if(client->framing == MOCK_HTTP) {
+        handle_http(client);
+        return 1;
+    }
+    if(client->framing == MOCK_NEW && !handle_handshake(client)) return 1;
+    while(!client->closing && handle_frame(client));
+    return 1;
+}
+
+/* returns 0 once the client is gone, or was closing and has had everything */
+static int client_write(MockClient *client) {
+    while(client->out.len > 0) {
+        ssize_t len = send(client->fd, client->out.data + client->out.start, client->out.len, MSG_NOSIGNAL);
+        if(len < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client->bytes_out += (uint64_t) len;
+        buffer_consume(&client->out, (size_t) len);
+    }
+    return !client->closing;
+}
+
+static int mock_listen(const char *address, int port) {
+    struct sockaddr_in sin;
+    int fd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons((uint16_t) port);
+    if(fd < 0 || inet_pton(AF_INET, address, &sin.sin_addr) != 1) {
+        fprintf(stderr, "Bad address: %s\n", address);
+        exit(1);
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(fd, (struct sockaddr *) &sin, sizeof(sin)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "Can't listen on %s:%d: %s\n", address, port, strerror(errno));
+        exit(1);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static int64_t rate_next(int64_t started, uint64_t sent, double rate) {
+    return started + (int64_t) ((double) (sent + 1) * 1000000 / rate);
+}
+
+/* sends whatever is due by now, and returns when something is due next */
+static int64_t generate(int64_t now) {
+    int64_t next = now + 1000000;
+    unsigned i, j;
+
+    if(opt_churn_rate > 0 && world_size > 0) {
+        while(rate_next(churn_started, churn_sent, opt_churn_rate) <= now) send_churn();
+        next = rate_next(churn_started, churn_sent, opt_churn_rate);
+    }
+
+    if(opt_flood_rate <= 0) return next;
+    for(i = 0; i < client_count; i++) {
+        MockClient *client = clients[i];
+        for(j = 0; j < client->channel_count; j++) {
+            MockChannel *channel = &client->channels[j];
+            int64_t due;
+            while((due = rate_next(channel->started, channel->sent, opt_flood_rate)) <= now) {
+                /* the timestamp says when it should have gone out, so falling */
+                /* behind shows up in the latency, but a client that stopped */
+                /* reading doesn't get to use up all of our memory */
+                if(client->out.len > MOCK_MAX_BACKLOG) client->dropped++;
+                else send_flood(client, channel, due);
+                channel->sent++;
+            }
+            if(due < next) next = due;
+        }
+    }
+    return next;
+}
+
+static void send_pings(void) {
+    unsigned i;
+    for(i = 0; i < client_count; i++) {
+        if(clients[i]->identified) send_simple(clients[i], "PIN", NULL);
+    }
+}
+
+static void stop(int sig) {
+    (void) sig;
+    stopping = 1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [options]\n"
+        "  -a ADDRESS  address to listen on (default 127.0.0.1)\n"
+        "  -p PORT     chat port (default %d)\n"
+        "  -t PORT     ticket page port, 0 for none (default %d)\n"
+        "  -c N        characters online at login (default 1000)\n"
+        "  -u N        characters in each channel (default 100)\n"
+        "  -f RATE     messages per second in each joined channel (default 0)\n"
+        "  -l LENGTH   length of those messages (default 80)\n"
+        "  -r RATE     characters logging in or out per second (default 0)\n"
+        "  -i SECONDS  time between pings (default 30)\n"
+        "  -s SEED     seed for the names, statuses and traffic\n"
+        "  -v          print what the clients send\n", name, MOCK_CHAT_PORT, MOCK_TICKET_PORT);
+}
+
+int main(int argc, char *argv[]) {
+    const char *address = "127.0.0.1";
+    int chat_port = MOCK_CHAT_PORT, ticket_port = MOCK_TICKET_PORT;
+    int chat_fd, ticket_fd = -1, opt;
+    struct pollfd *fds = NULL;
+    int64_t now, next, next_ping;
+    unsigned i;
+
+    while((opt = getopt(argc, argv, "a:p:t:c:u:f:l:r:i:s:vh")) != -1) {
+        switch(opt) {
+        case 'a': address = optarg; break;
+        case 'p': chat_port = atoi(optarg); break;
+        case 't': ticket_port = atoi(optarg); break;
+        case 'c': opt_characters = (unsigned) strtoul(optarg, NULL, 10); break;
+        case 'u': opt_channel_users = (unsigned) strtoul(optarg, NULL, 10); break;
+        case 'f': opt_flood_rate = strtod(optarg, NULL); break;
+        case 'l': opt_message_length = (unsigned) strtoul(optarg, NULL, 10); break;
+        case 'r': opt_churn_rate = strtod(optarg, NULL); break;
+        case 'i': opt_ping_interval = (unsigned) strtoul(optarg, NULL, 10); break;
+        case 's': rng_state = strtoull(optarg, NULL, 10) * 0x9E3779B97F4A7C15ULL + 1; break;
+        case 'v': opt_verbose = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(opt_ping_interval == 0) opt_ping_interval = 30;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    world_init();
+    chat_fd = mock_listen(address, chat_port);
+    if(ticket_port > 0) ticket_fd = mock_listen(address, ticket_port);
+    printf("Chat on %s:%d", address, chat_port);
+    if(ticket_fd >= 0) printf(", tickets from http://%s:%d/", address, ticket_port);
+    printf(", %u characters online\n", online_count);
+
+    churn_started = mock_now();
+    next_ping = churn_started + (int64_t) opt_ping_interval * 1000000;
+    while(!stopping) {
+        int timeout;
+
+        now = mock_now();
+        if(now >= next_ping) {
+            send_pings();
+            next_ping = now + (int64_t) opt_ping_interval * 1000000;
+        }
+        next = generate(now);
+        if(next > next_ping) next = next_ping;
+        timeout = next > now ? (int) ((next - now + 999) / 1000) : 0;
+
+        fds = mock_alloc(fds, sizeof(struct pollfd) * (client_count + 2));
+        fds[0].fd = chat_fd;
+        fds[1].fd = ticket_fd;
+        fds[0].events = fds[1].events = POLLIN;
+        for(i = 0; i < client_count; i++) {
+            fds[i + 2].fd = clients[i]->fd;
+            fds[i + 2].events = POLLIN | (clients[i]->out.len > 0 ? POLLOUT : 0);
+        }
+        if(poll(fds, client_count + 2, timeout) < 0) {
+            if(errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        /* clients may go away below, so walk them from the end */
+        for(i = client_count; i-- > 0; ) {
+            MockClient *client = clients[i];
+            short revents = fds[i + 2].revents;
+            int alive = 1;
+            if(revents & (POLLIN | POLLHUP | POLLERR)) alive = client_read(client);
+            if(alive) alive = client_write(client);
+            if(!alive) client_free(client);
+        }
+
+        if(fds[0].revents & POLLIN) {
+            int fd;
+            while((fd = accept(chat_fd, NULL, NULL)) >= 0) client_new(fd, MOCK_NEW);
+        }
+        if(ticket_fd >= 0 && (fds[1].revents & POLLIN)) {
+            int fd;
+            while((fd = accept(ticket_fd, NULL, NULL)) >= 0) client_new(fd, MOCK_HTTP);
+        }
+    }
+
+    while(client_count > 0) client_free(clients[client_count - 1]);
+    printf("%llu characters logged in or out, %llu tickets handed out\n",
+        (unsigned long long) churn_sent, (unsigned long long) tickets_issued);
+    return 0;
+}
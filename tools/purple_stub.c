@@ -0,0 +1,1208 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "purple_stub.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+
+typedef struct StubInput_ StubInput;
+typedef struct StubTimeout_ StubTimeout;
+
+struct StubInput_ {
+    guint handle;
+    gint fd;
+    PurpleInputCondition cond;
+    PurpleInputFunction func;
+    gpointer data;
+};
+
+struct StubTimeout_ {
+    guint handle;
+    gint64 due;
+    gint64 interval;
+    GSourceFunc func;
+    gpointer data;
+};
+
+PurpleStubStats purple_stub_stats;
+
+static gboolean verbose;
+static gchar *last_error;
+static gchar *allowed_host;
+static PurpleStubChatHook chat_hook;
+static guint next_handle = 1;
+static GList *inputs;
+static GList *timeouts;
+static GHashTable *settings;
+
+static GHashTable *groups; /* name -> PurpleGroup */
+static GHashTable *buddies; /* normalized name -> GSList of PurpleBuddy */
+static GHashTable *chats; /* normalized channel -> PurpleChat */
+static GList *conversations;
+
+/* the Pidgin side of the plugin needs GTK, so it is left out */
+void flist_pidgin_init() {
+}
+
+static gchar *stub_normalize(const gchar *name) {
+    return g_utf8_strdown(name, -1);
+}
+
+void purple_stub_init(gboolean verbose_debug) {
+    verbose = verbose_debug;
+    settings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    groups = g_hash_table_new(g_str_hash, g_str_equal);
+    buddies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    chats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+/* frees a buddy list node and everything below it */
+static void stub_node_free(PurpleBlistNode *node) {
+    while(node->child) {
+        PurpleBlistNode *child = node->child;
+        node->child = child->next;
+        stub_node_free(child);
+    }
+    if(node->settings) g_hash_table_destroy(node->settings);
+    switch(node->type) {
+        case PURPLE_BLIST_GROUP_NODE:
+            g_free(((PurpleGroup *) node)->name);
+            break;
+        case PURPLE_BLIST_BUDDY_NODE:
+            g_free(((PurpleBuddy *) node)->name);
+            g_free(((PurpleBuddy *) node)->alias);
+            break;
+        case PURPLE_BLIST_CHAT_NODE:
+            g_free(((PurpleChat *) node)->alias);
+            g_hash_table_destroy(((PurpleChat *) node)->components);
+            break;
+        default:
+            break;
+    }
+    g_free(node);
+}
+
+static void stub_conversation_free(PurpleConversation *conv) {
+    if(conv->type == PURPLE_CONV_TYPE_CHAT) {
+        g_free(conv->u.chat->topic);
+        g_free(conv->u.chat->nick);
+        g_free(conv->u.chat);
+    } else {
+        g_free(conv->u.im);
+    }
+    g_hash_table_destroy(conv->data);
+    g_free(conv->name);
+    g_free(conv->title);
+    g_free(conv);
+}
+
+void purple_stub_reset(void) {
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, groups);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) stub_node_free(value);
+    g_hash_table_iter_init(&iter, buddies);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) g_slist_free(value);
+    g_hash_table_remove_all(groups);
+    g_hash_table_remove_all(buddies);
+    g_hash_table_remove_all(chats);
+    g_hash_table_remove_all(settings);
+
+    g_list_foreach(conversations, (GFunc) stub_conversation_free, NULL);
+    g_list_free(conversations);
+    conversations = NULL;
+    g_list_foreach(inputs, (GFunc) g_free, NULL);
+    g_list_free(inputs);
+    inputs = NULL;
+    g_list_foreach(timeouts, (GFunc) g_free, NULL);
+    g_list_free(timeouts);
+    timeouts = NULL;
+
+    g_free(last_error);
+    last_error = NULL;
+    memset(&purple_stub_stats, 0, sizeof(purple_stub_stats));
+}
+
+void purple_stub_set_setting(const gchar *name, const gchar *value) {
+    g_hash_table_replace(settings, g_strdup(name), g_strdup(value));
+}
+
+void purple_stub_set_chat_hook(PurpleStubChatHook hook) {
+    chat_hook = hook;
+}
+
+void purple_stub_allow_host(const gchar *host) {
+    g_free(allowed_host);
+    allowed_host = g_strdup(host);
+}
+
+const gchar *purple_stub_error(void) {
+    return last_error;
+}
+
+/* debug.h */
+
+static void stub_debug(const char *category, const char *format, va_list args) {
+    if(!verbose) return;
+    fprintf(stderr, "%s: ", category);
+    vfprintf(stderr, format, args);
+}
+
+void purple_debug(PurpleDebugLevel level, const char *category, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    stub_debug(category, format, args);
+    va_end(args);
+}
+
+void purple_debug_info(const char *category, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    stub_debug(category, format, args);
+    va_end(args);
+}
+
+void purple_debug_warning(const char *category, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    stub_debug(category, format, args);
+    va_end(args);
+}
+
+void purple_debug_error(const char *category, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    stub_debug(category, format, args);
+    va_end(args);
+}
+
+/* eventloop.h */
+
+guint purple_input_add(int fd, PurpleInputCondition cond, PurpleInputFunction func, gpointer user_data) {
+    StubInput *input = g_new0(StubInput, 1);
+    input->handle = next_handle++;
+    input->fd = fd;
+    input->cond = cond;
+    input->func = func;
+    input->data = user_data;
+    inputs = g_list_append(inputs, input);
+    return input->handle;
+}
+
+static StubInput *stub_find_input(guint handle) {
+    GList *cur;
+    for(cur = inputs; cur; cur = cur->next) {
+        StubInput *input = cur->data;
+        if(input->handle == handle) return input;
+    }
+    return NULL;
+}
+
+gboolean purple_input_remove(guint handle) {
+    StubInput *input = stub_find_input(handle);
+    if(!input) return FALSE;
+    inputs = g_list_remove(inputs, input);
+    g_free(input);
+    return TRUE;
+}
+
+guint purple_timeout_add_seconds(guint interval, GSourceFunc function, gpointer data) {
+    StubTimeout *timeout = g_new0(StubTimeout, 1);
+    timeout->handle = next_handle++;
+    timeout->interval = (gint64) interval * G_USEC_PER_SEC;
+    timeout->due = g_get_monotonic_time() + timeout->interval;
+    timeout->func = function;
+    timeout->data = data;
+    timeouts = g_list_append(timeouts, timeout);
+    return timeout->handle;
+}
+
+static StubTimeout *stub_find_timeout(guint handle) {
+    GList *cur;
+    for(cur = timeouts; cur; cur = cur->next) {
+        StubTimeout *timeout = cur->data;
+        if(timeout->handle == handle) return timeout;
+    }
+    return NULL;
+}
+
+gboolean purple_timeout_remove(guint handle) {
+    StubTimeout *timeout = stub_find_timeout(handle);
+    if(!timeout) return FALSE;
+    timeouts = g_list_remove(timeouts, timeout);
+    g_free(timeout);
+    return TRUE;
+}
+
+/* Callbacks may add and remove handlers, so we work from a list of the */
+/* handles that were ready and look each one up again before running it. */
+guint purple_stub_dispatch(gint timeout) {
+    GArray *fds = g_array_new(FALSE, FALSE, sizeof(struct pollfd));
+    GArray *handles = g_array_new(FALSE, FALSE, sizeof(guint));
+    gint64 now = g_get_monotonic_time();
+    guint ran = 0, i;
+    GList *cur;
+
+    for(cur = timeouts; cur; cur = cur->next) {
+        StubTimeout *t = cur->data;
+        gint wait = (gint) MAX((t->due - now + 999) / 1000, 0);
+        if(timeout < 0 || wait < timeout) timeout = wait;
+    }
+    for(cur = inputs; cur; cur = cur->next) {
+        StubInput *input = cur->data;
+        struct pollfd pfd;
+        pfd.fd = input->fd;
+        pfd.events = ((input->cond & PURPLE_INPUT_READ) ? POLLIN : 0) | ((input->cond & PURPLE_INPUT_WRITE) ? POLLOUT : 0);
+        pfd.revents = 0;
+        g_array_append_val(fds, pfd);
+        g_array_append_val(handles, input->handle);
+    }
+
+    if((fds->len > 0 || timeout >= 0) && poll((struct pollfd *) fds->data, fds->len, timeout) > 0) {
+        for(i = 0; i < fds->len; i++) {
+            struct pollfd *pfd = &g_array_index(fds, struct pollfd, i);
+            StubInput *input = stub_find_input(g_array_index(handles, guint, i));
+            PurpleInputCondition cond = 0;
+            if(!input) continue;
+            /* a closed socket is reported as readable, so recv() sees it */
+            if(pfd->revents & (POLLIN | POLLHUP | POLLERR)) cond |= input->cond & PURPLE_INPUT_READ;
+            if(pfd->revents & POLLOUT) cond |= input->cond & PURPLE_INPUT_WRITE;
+            if(!cond) continue;
+            input->func(input->data, input->fd, cond);
+            ran++;
+        }
+    }
+
+    g_array_set_size(handles, 0);
+    now = g_get_monotonic_time();
+    for(cur = timeouts; cur; cur = cur->next) {
+        StubTimeout *t = cur->data;
+        if(t->due <= now) g_array_append_val(handles, t->handle);
+    }
+    for(i = 0; i < handles->len; i++) {
+        StubTimeout *t = stub_find_timeout(g_array_index(handles, guint, i));
+        if(!t) continue;
+        ran++;
+        if(t->func(t->data)) {
+            t->due = now + t->interval;
+        } else if((t = stub_find_timeout(g_array_index(handles, guint, i)))) {
+            purple_timeout_remove(t->handle);
+        }
+    }
+
+    g_array_free(fds, TRUE);
+    g_array_free(handles, TRUE);
+    return ran;
+}
+
+/* account.h, accountopt.h, connection.h */
+
+int purple_account_get_int(const PurpleAccount *account, const char *name, int default_value) {
+    const gchar *value = g_hash_table_lookup(settings, name);
+    return value ? atoi(value) : default_value;
+}
+
+gboolean purple_account_get_bool(const PurpleAccount *account, const char *name, gboolean default_value) {
+    const gchar *value = g_hash_table_lookup(settings, name);
+    if(!value) return default_value;
+    return !strcmp(value, "1") || !g_ascii_strcasecmp(value, "true");
+}
+
+const char *purple_account_get_string(const PurpleAccount *account, const char *name, const char *default_value) {
+    const gchar *value = g_hash_table_lookup(settings, name);
+    return value ? value : default_value;
+}
+
+void purple_account_set_int(PurpleAccount *account, const char *name, int value) {
+    g_hash_table_replace(settings, g_strdup(name), g_strdup_printf("%d", value));
+}
+
+void purple_account_set_bool(PurpleAccount *account, const char *name, gboolean value) {
+    purple_stub_set_setting(name, value ? "1" : "0");
+}
+
+void purple_account_set_string(PurpleAccount *account, const char *name, const char *value) {
+    purple_stub_set_setting(name, value ? value : "");
+}
+
+PurpleConnection *purple_account_get_connection(const PurpleAccount *account) {
+    return account->gc;
+}
+
+const char *purple_account_get_username(const PurpleAccount *account) {
+    return account->username;
+}
+
+const char *purple_account_get_password(const PurpleAccount *account) {
+    return account->password;
+}
+
+const char *purple_account_get_alias(const PurpleAccount *account) {
+    return account->alias;
+}
+
+void purple_account_set_alias(PurpleAccount *account, const char *alias) {
+    g_free(account->alias);
+    account->alias = g_strdup(alias);
+}
+
+PurpleAccount *purple_accounts_find(const char *name, const char *protocol) {
+    return NULL;
+}
+
+void purple_account_add_buddy(PurpleAccount *account, PurpleBuddy *buddy) {
+}
+
+void purple_account_add_buddies(PurpleAccount *account, GList *buddy_list) {
+}
+
+void *purple_account_request_authorization(PurpleAccount *account, const char *remote_user, const char *id,
+        const char *alias, const char *message, gboolean on_list, PurpleAccountRequestAuthorizationCb auth_cb,
+        PurpleAccountRequestAuthorizationCb deny_cb, void *user_data) {
+    return NULL;
+}
+
+PurpleAccountOption *purple_account_option_bool_new(const char *text, const char *pref_name, gboolean default_value) {
+    return NULL;
+}
+
+PurpleAccountOption *purple_account_option_int_new(const char *text, const char *pref_name, int default_value) {
+    return NULL;
+}
+
+PurpleAccountOption *purple_account_option_string_new(const char *text, const char *pref_name, const char *default_value) {
+    return NULL;
+}
+
+PurpleAccountUserSplit *purple_account_user_split_new(const char *text, const char *default_value, char sep) {
+    return NULL;
+}
+
+PurpleAccount *purple_connection_get_account(const PurpleConnection *gc) {
+    return gc->account;
+}
+
+void purple_connection_set_state(PurpleConnection *gc, PurpleConnectionState state) {
+    gc->state = state;
+}
+
+void purple_connection_error_reason(PurpleConnection *gc, PurpleConnectionError reason, const char *description) {
+    g_free(last_error);
+    last_error = g_strdup(description);
+    gc->wants_to_die = TRUE;
+}
+
+/* blist.h, buddyicon.h */
+
+static void stub_node_prepend(PurpleBlistNode *parent, PurpleBlistNode *node) {
+    node->parent = parent;
+    node->prev = NULL;
+    node->next = parent->child;
+    if(parent->child) parent->child->prev = node;
+    parent->child = node;
+}
+
+static void stub_node_unlink(PurpleBlistNode *node) {
+    if(node->prev) node->prev->next = node->next;
+    else if(node->parent) node->parent->child = node->next;
+    if(node->next) node->next->prev = node->prev;
+    node->parent = node->prev = node->next = NULL;
+}
+
+PurpleGroup *purple_find_group(const char *name) {
+    return g_hash_table_lookup(groups, name);
+}
+
+/* libpurple only adds a group once something is put in it; we add it now */
+PurpleGroup *purple_group_new(const char *name) {
+    PurpleGroup *group = purple_find_group(name);
+    if(group) return group;
+    group = g_new0(PurpleGroup, 1);
+    group->node.type = PURPLE_BLIST_GROUP_NODE;
+    group->name = g_strdup(name);
+    g_hash_table_insert(groups, group->name, group);
+    return group;
+}
+
+PurpleBuddy *purple_buddy_new(PurpleAccount *account, const char *name, const char *alias) {
+    PurpleBuddy *buddy = g_new0(PurpleBuddy, 1);
+    buddy->node.type = PURPLE_BLIST_BUDDY_NODE;
+    buddy->name = g_strdup(name);
+    buddy->alias = g_strdup(alias);
+    buddy->account = account;
+    return buddy;
+}
+
+/* takes the buddy out of its contact, and drops the contact once it's empty */
+static void stub_buddy_unlink(PurpleBuddy *buddy) {
+    PurpleBlistNode *contact = buddy->node.parent;
+    stub_node_unlink(&buddy->node);
+    if(contact && !contact->child) {
+        stub_node_unlink(contact);
+        stub_node_free(contact);
+    }
+}
+
+void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleContact *contact, PurpleGroup *group, PurpleBlistNode *node) {
+    if(buddy->node.parent) {
+        stub_buddy_unlink(buddy);
+    } else {
+        gchar *key = stub_normalize(buddy->name);
+        GSList *list = g_hash_table_lookup(buddies, key);
+        g_hash_table_replace(buddies, key, g_slist_prepend(list, buddy));
+        purple_stub_stats.buddies_added++;
+    }
+    if(!contact) {
+        if(!group) group = purple_group_new("Buddies");
+        contact = g_new0(PurpleContact, 1);
+        contact->node.type = PURPLE_BLIST_CONTACT_NODE;
+        stub_node_prepend(&group->node, &contact->node);
+    }
+    stub_node_prepend(&contact->node, &buddy->node);
+}
+
+void purple_blist_remove_buddy(PurpleBuddy *buddy) {
+    gchar *key = stub_normalize(buddy->name);
+    GSList *list = g_slist_remove(g_hash_table_lookup(buddies, key), buddy);
+
+    if(list) {
+        g_hash_table_replace(buddies, key, list);
+    } else {
+        g_hash_table_remove(buddies, key);
+        g_free(key);
+    }
+    stub_buddy_unlink(buddy);
+    stub_node_free(&buddy->node);
+    purple_stub_stats.buddies_removed++;
+}
+
+PurpleBuddy *purple_find_buddy(PurpleAccount *account, const char *name) {
+    gchar *key = stub_normalize(name);
+    GSList *cur = g_hash_table_lookup(buddies, key);
+
+    g_free(key);
+    for(; cur; cur = cur->next) {
+        PurpleBuddy *buddy = cur->data;
+        if(buddy->account == account) return buddy;
+    }
+    return NULL;
+}
+
+GSList *purple_find_buddies(PurpleAccount *account, const char *name) {
+    GSList *ret = NULL, *cur;
+
+    if(!name) {
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, buddies);
+        while(g_hash_table_iter_next(&iter, NULL, &value)) {
+            for(cur = value; cur; cur = cur->next) {
+                if(((PurpleBuddy *) cur->data)->account == account) ret = g_slist_prepend(ret, cur->data);
+            }
+        }
+    } else {
+        gchar *key = stub_normalize(name);
+        for(cur = g_hash_table_lookup(buddies, key); cur; cur = cur->next) {
+            if(((PurpleBuddy *) cur->data)->account == account) ret = g_slist_prepend(ret, cur->data);
+        }
+        g_free(key);
+    }
+    return ret;
+}
+
+const char *purple_buddy_get_name(const PurpleBuddy *buddy) {
+    return buddy->name;
+}
+
+PurpleAccount *purple_buddy_get_account(const PurpleBuddy *buddy) {
+    return buddy->account;
+}
+
+PurpleGroup *purple_buddy_get_group(PurpleBuddy *buddy) {
+    PurpleBlistNode *contact = buddy->node.parent;
+    return contact ? (PurpleGroup *) contact->parent : NULL;
+}
+
+PurpleChat *purple_chat_new(PurpleAccount *account, const char *alias, GHashTable *components) {
+    PurpleChat *chat = g_new0(PurpleChat, 1);
+    chat->node.type = PURPLE_BLIST_CHAT_NODE;
+    chat->alias = g_strdup(alias);
+    chat->components = components;
+    chat->account = account;
+    return chat;
+}
+
+void purple_blist_add_chat(PurpleChat *chat, PurpleGroup *group, PurpleBlistNode *node) {
+    if(chat->node.parent) {
+        stub_node_unlink(&chat->node);
+    } else {
+        const gchar *channel = g_hash_table_lookup(chat->components, "channel");
+        g_hash_table_replace(chats, stub_normalize(channel ? channel : chat->alias), chat);
+    }
+    if(!group) group = purple_group_new("Chats");
+    stub_node_prepend(&group->node, &chat->node);
+}
+
+PurpleChat *purple_blist_find_chat(PurpleAccount *account, const char *name) {
+    gchar *key = stub_normalize(name);
+    PurpleChat *chat = g_hash_table_lookup(chats, key);
+    g_free(key);
+    return chat && chat->account == account ? chat : NULL;
+}
+
+PurpleGroup *purple_chat_get_group(PurpleChat *chat) {
+    return (PurpleGroup *) chat->node.parent;
+}
+
+void purple_blist_remove_chat(PurpleChat *chat) {
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, chats);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        if(value == chat) {
+            g_hash_table_iter_remove(&iter);
+            break;
+        }
+    }
+    stub_node_unlink(&chat->node);
+    stub_node_free(&chat->node);
+}
+
+void purple_blist_alias_chat(PurpleChat *chat, const char *alias) {
+    g_free(chat->alias);
+    chat->alias = g_strdup(alias);
+}
+
+void purple_blist_node_set_int(PurpleBlistNode *node, const char *key, int value) {
+    if(!node->settings) node->settings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_hash_table_replace(node->settings, g_strdup(key), GINT_TO_POINTER(value));
+}
+
+int purple_blist_node_get_int(PurpleBlistNode *node, const char *key) {
+    return node->settings ? GPOINTER_TO_INT(g_hash_table_lookup(node->settings, key)) : 0;
+}
+
+void purple_buddy_icons_set_for_user(PurpleAccount *account, const char *username, void *icon_data, size_t icon_len, const char *checksum) {
+    g_free(icon_data);
+}
+
+/* conversation.h, server.h */
+
+PurpleConversation *purple_find_conversation_with_account(PurpleConversationType type, const char *name, const PurpleAccount *account) {
+    GList *cur;
+    for(cur = conversations; cur; cur = cur->next) {
+        PurpleConversation *conv = cur->data;
+        if((type == PURPLE_CONV_TYPE_ANY || conv->type == type) && conv->account == account
+                && !purple_utf8_strcasecmp(conv->name, name)) {
+            return conv;
+        }
+    }
+    return NULL;
+}
+
+PurpleConversation *purple_conversation_new(PurpleConversationType type, PurpleAccount *account, const char *name) {
+    PurpleConversation *conv = purple_find_conversation_with_account(type, name, account);
+    if(conv) return conv;
+
+    conv = g_new0(PurpleConversation, 1);
+    conv->type = type;
+    conv->account = account;
+    conv->name = g_strdup(name);
+    conv->title = g_strdup(name);
+    conv->data = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    if(type == PURPLE_CONV_TYPE_CHAT) {
+        conv->u.chat = g_new0(PurpleConvChat, 1);
+        conv->u.chat->conv = conv;
+    } else {
+        conv->u.im = g_new0(PurpleConvIm, 1);
+        conv->u.im->conv = conv;
+    }
+    conversations = g_list_prepend(conversations, conv);
+    return conv;
+}
+
+PurpleConversation *purple_find_chat(const PurpleConnection *gc, int id) {
+    GList *cur;
+    for(cur = conversations; cur; cur = cur->next) {
+        PurpleConversation *conv = cur->data;
+        if(conv->type == PURPLE_CONV_TYPE_CHAT && conv->account == gc->account
+                && conv->u.chat->id == id && !conv->u.chat->left) {
+            return conv;
+        }
+    }
+    return NULL;
+}
+
+PurpleConvChat *purple_conversation_get_chat_data(const PurpleConversation *conv) {
+    return conv->type == PURPLE_CONV_TYPE_CHAT ? conv->u.chat : NULL;
+}
+
+PurpleConvIm *purple_conversation_get_im_data(const PurpleConversation *conv) {
+    return conv->type == PURPLE_CONV_TYPE_IM ? conv->u.im : NULL;
+}
+
+PurpleConnection *purple_conversation_get_gc(const PurpleConversation *conv) {
+    return conv->account ? conv->account->gc : NULL;
+}
+
+const char *purple_conversation_get_name(const PurpleConversation *conv) {
+    return conv->name;
+}
+
+const char *purple_conversation_get_title(const PurpleConversation *conv) {
+    return conv->title;
+}
+
+void purple_conversation_autoset_title(PurpleConversation *conv) {
+}
+
+void purple_conversation_present(PurpleConversation *conv) {
+}
+
+void purple_conversation_set_data(PurpleConversation *conv, const char *key, gpointer data) {
+    g_hash_table_replace(conv->data, g_strdup(key), data);
+}
+
+gpointer purple_conversation_get_data(PurpleConversation *conv, const char *key) {
+    return g_hash_table_lookup(conv->data, key);
+}
+
+void purple_conversation_write(PurpleConversation *conv, const char *who, const char *message, PurpleMessageFlags flags, time_t mtime) {
+    purple_stub_stats.conversation_writes++;
+}
+
+void purple_conv_im_write(PurpleConvIm *im, const char *who, const char *message, PurpleMessageFlags flags, time_t mtime) {
+    purple_stub_stats.conversation_writes++;
+}
+
+void purple_conv_chat_write(PurpleConvChat *chat, const char *who, const char *message, PurpleMessageFlags flags, time_t mtime) {
+    purple_stub_stats.conversation_writes++;
+}
+
+int purple_conv_chat_get_id(const PurpleConvChat *chat) {
+    return chat->id;
+}
+
+gboolean purple_conv_chat_has_left(PurpleConvChat *chat) {
+    return chat->left;
+}
+
+void purple_conv_chat_set_topic(PurpleConvChat *chat, const char *who, const char *topic) {
+    g_free(chat->topic);
+    chat->topic = g_strdup(topic);
+}
+
+void purple_conv_chat_set_nick(PurpleConvChat *chat, const char *nick) {
+    g_free(chat->nick);
+    chat->nick = g_strdup(nick);
+}
+
+void purple_conv_chat_add_user(PurpleConvChat *chat, const char *user, const char *extra_msg, PurpleConvChatBuddyFlags flags, gboolean new_arrival) {
+    purple_stub_stats.chat_users_added++;
+}
+
+void purple_conv_chat_add_users(PurpleConvChat *chat, GList *users, GList *extra_msgs, GList *flags, gboolean new_arrivals) {
+    purple_stub_stats.chat_users_added += g_list_length(users);
+}
+
+void purple_conv_chat_remove_user(PurpleConvChat *chat, const char *user, const char *reason) {
+    purple_stub_stats.chat_users_removed++;
+}
+
+void purple_conv_chat_user_set_flags(PurpleConvChat *chat, const char *user, PurpleConvChatBuddyFlags flags) {
+}
+
+GList *purple_conv_chat_get_users(PurpleConvChat *chat) {
+    return chat->in_room; /* users are only counted, so this stays empty */
+}
+
+gboolean purple_conv_custom_smiley_add(PurpleConversation *conv, const char *smile, const char *cksum_type, const char *chksum, gboolean remote) {
+    return FALSE;
+}
+
+void purple_conv_custom_smiley_write(PurpleConversation *conv, const char *smile, const guchar *data, gsize size) {
+}
+
+void purple_conv_custom_smiley_close(PurpleConversation *conv, const char *smile) {
+}
+
+PurpleConversation *serv_got_joined_chat(PurpleConnection *gc, int id, const char *name) {
+    PurpleConversation *conv = purple_conversation_new(PURPLE_CONV_TYPE_CHAT, gc->account, name);
+    conv->u.chat->id = id;
+    conv->u.chat->left = FALSE;
+    return conv;
+}
+
+void serv_got_chat_left(PurpleConnection *g, int id) {
+    PurpleConversation *conv = purple_find_chat(g, id);
+    if(conv) conv->u.chat->left = TRUE;
+}
+
+void serv_got_chat_in(PurpleConnection *g, int id, const char *who, PurpleMessageFlags flags, const char *message, time_t mtime) {
+    purple_stub_stats.chat_messages++;
+    if(chat_hook) chat_hook(g, id, who, message);
+}
+
+void serv_got_im(PurpleConnection *gc, const char *who, const char *msg, PurpleMessageFlags flags, time_t mtime) {
+    purple_stub_stats.im_messages++;
+}
+
+void serv_got_typing(PurpleConnection *gc, const char *name, int timeout, PurpleTypingState state) {
+}
+
+void serv_got_chat_invite(PurpleConnection *gc, const char *name, const char *who, const char *message, GHashTable *data) {
+}
+
+void serv_join_chat(PurpleConnection *gc, GHashTable *data) {
+}
+
+/* prpl.h, plugin.h, status.h, value.h, cmds.h, proxy.h */
+
+void purple_prpl_got_user_status(PurpleAccount *account, const char *name, const char *status_id, ...) {
+    purple_stub_stats.user_status++;
+}
+
+void purple_prpl_got_account_actions(PurpleAccount *account) {
+}
+
+gboolean purple_plugin_register(PurplePlugin *plugin) {
+    return TRUE;
+}
+
+PurplePluginAction *purple_plugin_action_new(const char *label, void (*callback)(PurplePluginAction *)) {
+    return NULL;
+}
+
+PurpleMenuAction *purple_menu_action_new(const char *label, PurpleCallback callback, gpointer data, GList *children) {
+    return NULL;
+}
+
+PurpleStatusType *purple_status_type_new(PurpleStatusPrimitive primitive, const char *id, const char *name, gboolean user_settable) {
+    return NULL;
+}
+
+PurpleStatusType *purple_status_type_new_with_attrs(PurpleStatusPrimitive primitive, const char *id, const char *name,
+        gboolean saveable, gboolean user_settable, gboolean independent, const char *attr_id, const char *attr_name,
+        PurpleValue *attr_value, ...) {
+    return NULL;
+}
+
+PurpleValue *purple_value_new(PurpleType type, ...) {
+    return NULL;
+}
+
+PurpleCmdId purple_cmd_register(const gchar *cmd, const gchar *args, PurpleCmdPriority p, PurpleCmdFlag f,
+        const gchar *prpl_id, PurpleCmdFunc func, const gchar *helpstr, void *data) {
+    return next_handle++;
+}
+
+/* Connections to the allowed host are made right away, and reported from */
+/* a timeout, the way libpurple reports them from the main loop. */
+struct _PurpleProxyConnectData {
+    guint timeout;
+    int fd;
+    gchar *error;
+    PurpleProxyConnectFunction func;
+    gpointer data;
+};
+
+static gboolean stub_host_allowed(const gchar *host) {
+    return allowed_host && host && !g_ascii_strcasecmp(host, allowed_host);
+}
+
+/* returns a blocking socket, or -1 and the reason in error */
+static int stub_connect(const gchar *host, int port, gchar **error) {
+    struct addrinfo hints, *addrs, *addr;
+    gchar service[16];
+    int fd = -1, ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    g_snprintf(service, sizeof(service), "%d", port);
+    if((ret = getaddrinfo(host, service, &hints, &addrs)) != 0) {
+        *error = g_strdup(gai_strerror(ret));
+        return -1;
+    }
+    for(addr = addrs; addr && fd < 0; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if(fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    if(fd < 0) *error = g_strdup_printf("Could not connect to %s:%d: %s", host, port, g_strerror(errno));
+    return fd;
+}
+
+static gboolean stub_proxy_connected(gpointer user_data) {
+    PurpleProxyConnectData *connect_data = user_data;
+    connect_data->func(connect_data->data, connect_data->fd, connect_data->error);
+    g_free(connect_data->error);
+    g_free(connect_data);
+    return FALSE;
+}
+
+PurpleProxyConnectData *purple_proxy_connect(void *handle, PurpleAccount *account, const char *host, int port,
+        PurpleProxyConnectFunction connect_cb, gpointer data) {
+    PurpleProxyConnectData *connect_data;
+
+    if(!stub_host_allowed(host)) return NULL;
+    connect_data = g_new0(PurpleProxyConnectData, 1);
+    connect_data->fd = stub_connect(host, port, &connect_data->error);
+    if(connect_data->fd >= 0) {
+        fcntl(connect_data->fd, F_SETFL, fcntl(connect_data->fd, F_GETFL) | O_NONBLOCK);
+    }
+    connect_data->func = connect_cb;
+    connect_data->data = data;
+    connect_data->timeout = purple_timeout_add_seconds(0, stub_proxy_connected, connect_data);
+    return connect_data;
+}
+
+void purple_proxy_connect_cancel(PurpleProxyConnectData *connect_data) {
+    if(!connect_data) return;
+    purple_timeout_remove(connect_data->timeout);
+    if(connect_data->fd >= 0) close(connect_data->fd);
+    g_free(connect_data->error);
+    g_free(connect_data);
+}
+
+/* notify.h, request.h, roomlist.h: there is nobody to show these to */
+
+void *purple_notify_message(void *handle, PurpleNotifyMsgType type, const char *title, const char *primary,
+        const char *secondary, PurpleNotifyCloseCallback cb, gpointer user_data) {
+    return NULL;
+}
+
+void *purple_notify_userinfo(PurpleConnection *gc, const char *who, PurpleNotifyUserInfo *user_info,
+        PurpleNotifyCloseCallback cb, gpointer user_data) {
+    return NULL;
+}
+
+PurpleNotifyUserInfo *purple_notify_user_info_new(void) {
+    return NULL;
+}
+
+void purple_notify_user_info_destroy(PurpleNotifyUserInfo *user_info) {
+}
+
+void purple_notify_user_info_add_pair(PurpleNotifyUserInfo *user_info, const char *label, const char *value) {
+}
+
+void purple_notify_user_info_add_section_break(PurpleNotifyUserInfo *user_info) {
+}
+
+void purple_notify_user_info_add_section_header(PurpleNotifyUserInfo *user_info, const char *label) {
+}
+
+void *purple_request_input(void *handle, const char *title, const char *primary, const char *secondary,
+        const char *default_value, gboolean multiline, gboolean masked, gchar *hint, const char *ok_text,
+        GCallback ok_cb, const char *cancel_text, GCallback cancel_cb, PurpleAccount *account, const char *who,
+        PurpleConversation *conv, void *user_data) {
+    return NULL;
+}
+
+void *purple_request_fields(void *handle, const char *title, const char *primary, const char *secondary,
+        PurpleRequestFields *fields, const char *ok_text, GCallback ok_cb, const char *cancel_text,
+        GCallback cancel_cb, PurpleAccount *account, const char *who, PurpleConversation *conv, void *user_data) {
+    return NULL;
+}
+
+void purple_request_close_with_handle(void *handle) {
+}
+
+PurpleRequestFields *purple_request_fields_new(void) {
+    return NULL;
+}
+
+void purple_request_fields_add_group(PurpleRequestFields *fields, PurpleRequestFieldGroup *group) {
+}
+
+PurpleRequestFieldGroup *purple_request_field_group_new(const char *title) {
+    return NULL;
+}
+
+void purple_request_field_group_add_field(PurpleRequestFieldGroup *group, PurpleRequestField *field) {
+}
+
+PurpleRequestField *purple_request_field_string_new(const char *id, const char *text, const char *default_value, gboolean multiline) {
+    return NULL;
+}
+
+PurpleRequestField *purple_request_field_bool_new(const char *id, const char *text, gboolean default_value) {
+    return NULL;
+}
+
+PurpleRequestField *purple_request_field_choice_new(const char *id, const char *text, int default_value) {
+    return NULL;
+}
+
+void purple_request_field_choice_add(PurpleRequestField *field, const char *label) {
+}
+
+const char *purple_request_fields_get_string(const PurpleRequestFields *fields, const char *id) {
+    return NULL;
+}
+
+gboolean purple_request_fields_get_bool(const PurpleRequestFields *fields, const char *id) {
+    return FALSE;
+}
+
+int purple_request_fields_get_choice(const PurpleRequestFields *fields, const char *id) {
+    return -1;
+}
+
+PurpleRoomlist *purple_roomlist_new(PurpleAccount *account) {
+    return NULL;
+}
+
+void purple_roomlist_unref(PurpleRoomlist *list) {
+}
+
+void purple_roomlist_show_with_account(PurpleAccount *account) {
+}
+
+void purple_roomlist_set_in_progress(PurpleRoomlist *list, gboolean in_progress) {
+}
+
+void purple_roomlist_set_fields(PurpleRoomlist *list, GList *fields) {
+    g_list_free(fields);
+}
+
+PurpleRoomlistField *purple_roomlist_field_new(PurpleRoomlistFieldType type, const gchar *label, const gchar *name, gboolean hidden) {
+    return NULL;
+}
+
+PurpleRoomlistRoom *purple_roomlist_room_new(PurpleRoomlistRoomType type, const gchar *name, PurpleRoomlistRoom *parent) {
+    return NULL;
+}
+
+void purple_roomlist_room_add_field(PurpleRoomlist *list, PurpleRoomlistRoom *room, gconstpointer field) {
+}
+
+void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room) {
+}
+
+/* util.h */
+
+/* Only requests to the allowed host are made, the same way as connections: */
+/* the whole response is read at once, and handed over from a timeout. */
+struct _PurpleUtilFetchUrlData {
+    guint timeout;
+    GString *response;
+    gchar *error;
+    PurpleUtilFetchUrlCallback func;
+    gpointer data;
+};
+
+static void stub_fetch_free(PurpleUtilFetchUrlData *url_data) {
+    g_string_free(url_data->response, TRUE);
+    g_free(url_data->error);
+    g_free(url_data);
+}
+
+static gboolean stub_fetch_done(gpointer user_data) {
+    PurpleUtilFetchUrlData *url_data = user_data;
+    if(url_data->error) {
+        url_data->func(url_data, url_data->data, NULL, 0, url_data->error);
+    } else {
+        url_data->func(url_data, url_data->data, url_data->response->str, url_data->response->len, NULL);
+    }
+    stub_fetch_free(url_data);
+    return FALSE;
+}
+
+PurpleUtilFetchUrlData *purple_util_fetch_url_request(const gchar *url, gboolean full, const gchar *user_agent,
+        gboolean http11, const gchar *request, gboolean include_headers, PurpleUtilFetchUrlCallback callback, gpointer data) {
+    PurpleUtilFetchUrlData *url_data;
+    gchar *host, *path, *built = NULL, buf[16384];
+    gssize len;
+    int port, fd;
+
+    purple_url_parse(url, &host, &port, &path, NULL, NULL);
+    if(!stub_host_allowed(host)) {
+        g_free(host);
+        g_free(path);
+        return NULL;
+    }
+
+    url_data = g_new0(PurpleUtilFetchUrlData, 1);
+    url_data->response = g_string_new(NULL);
+    url_data->func = callback;
+    url_data->data = data;
+    if(!request) {
+        request = built = g_strdup_printf("GET /%s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n", path, host);
+    }
+
+    fd = stub_connect(host, port, &url_data->error);
+    if(fd >= 0) {
+        if(write(fd, request, strlen(request)) < 0) {
+            url_data->error = g_strdup_printf("Could not send the request: %s", g_strerror(errno));
+        }
+        while((len = read(fd, buf, sizeof(buf))) > 0) g_string_append_len(url_data->response, buf, len);
+        close(fd);
+    }
+    if(!url_data->error && !include_headers) {
+        gchar *body = strstr(url_data->response->str, "\r\n\r\n");
+        if(body) g_string_erase(url_data->response, 0, (body - url_data->response->str) + 4);
+    }
+    url_data->timeout = purple_timeout_add_seconds(0, stub_fetch_done, url_data);
+
+    g_free(built);
+    g_free(host);
+    g_free(path);
+    return url_data;
+}
+
+void purple_util_fetch_url_cancel(PurpleUtilFetchUrlData *url_data) {
+    if(!url_data) return;
+    purple_timeout_remove(url_data->timeout);
+    stub_fetch_free(url_data);
+}
+
+gboolean purple_url_parse(const char *url, char **ret_host, int *ret_port, char **ret_path, char **ret_user, char **ret_passwd) {
+    const gchar *host = url, *path;
+    gchar *port;
+    gchar *host_port;
+    int default_port = 80;
+
+    if(!g_ascii_strncasecmp(url, "http://", 7)) {
+        host += 7;
+    } else if(!g_ascii_strncasecmp(url, "https://", 8)) {
+        host += 8;
+        default_port = 443;
+    }
+    path = strchr(host, '/');
+    host_port = path ? g_strndup(host, (gsize) (path - host)) : g_strdup(host);
+    port = strchr(host_port, ':');
+    if(port) *port++ = '\0';
+
+    if(ret_host) *ret_host = g_strdup(host_port);
+    if(ret_port) *ret_port = port ? atoi(port) : default_port;
+    if(ret_path) *ret_path = g_strdup(path ? path + 1 : "");
+    if(ret_user) *ret_user = NULL;
+    if(ret_passwd) *ret_passwd = NULL;
+    g_free(host_port);
+    return TRUE;
+}
+
+const char *purple_url_encode(const char *str) {
+    static gchar buf[8192];
+    gsize len = 0;
+
+    for(; *str && len + 4 < sizeof(buf); str++) {
+        guchar c = (guchar) *str;
+        if(g_ascii_isalnum(c) || strchr("-_.~", c)) {
+            buf[len++] = (gchar) c;
+        } else {
+            g_snprintf(buf + len, 4, "%%%02X", c);
+            len += 3;
+        }
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+int purple_utf8_strcasecmp(const char *a, const char *b) {
+    gchar *a_folded, *b_folded;
+    int ret;
+
+    if(!a || !b) return a ? 1 : (b ? -1 : 0);
+    a_folded = g_utf8_casefold(a, -1);
+    b_folded = g_utf8_casefold(b, -1);
+    ret = g_utf8_collate(a_folded, b_folded);
+    g_free(a_folded);
+    g_free(b_folded);
+    return ret;
+}
+
+const char *purple_normalize_nocase(const PurpleAccount *account, const char *str) {
+    static gchar buf[2048];
+    gchar *lower = g_utf8_strdown(str, -1);
+    g_strlcpy(buf, lower, sizeof(buf));
+    g_free(lower);
+    return buf;
+}
+
+gchar *purple_markup_escape_text(const gchar *text, gssize length) {
+    return g_markup_escape_text(text, length);
+}
+
+/* only the entities the plugin and the server produce */
+static const gchar *stub_unescape_entity(const gchar *text, GString *out) {
+    static const struct { const gchar *entity; gchar c; } entities[] = {
+        { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' }, { "&#39;", '\'' }
+    };
+    guint i;
+
+    for(i = 0; i < G_N_ELEMENTS(entities); i++) {
+        gsize len = strlen(entities[i].entity);
+        if(!strncmp(text, entities[i].entity, len)) {
+            g_string_append_c(out, entities[i].c);
+            return text + len;
+        }
+    }
+    g_string_append_c(out, *text);
+    return text + 1;
+}
+
+gchar *purple_unescape_html(const char *html) {
+    GString *out;
+
+    if(!html) return NULL;
+    out = g_string_sized_new(strlen(html));
+    while(*html) {
+        if(!g_ascii_strncasecmp(html, "<br>", 4)) {
+            g_string_append_c(out, '\n');
+            html += 4;
+        } else if(*html == '&') {
+            html = stub_unescape_entity(html, out);
+        } else {
+            g_string_append_c(out, *html++);
+        }
+    }
+    return g_string_free(out, FALSE);
+}
+
+char *purple_markup_strip_html(const char *str) {
+    GString *out;
+
+    if(!str) return NULL;
+    out = g_string_sized_new(strlen(str));
+    while(*str) {
+        if(*str == '<') {
+            const gchar *end = strchr(str, '>');
+            if(!end) break;
+            if(!g_ascii_strncasecmp(str, "<br", 3)) g_string_append_c(out, '\n');
+            str = end + 1;
+        } else if(*str == '&') {
+            str = stub_unescape_entity(str, out);
+        } else {
+            g_string_append_c(out, *str++);
+        }
+    }
+    return g_string_free(out, FALSE);
+}
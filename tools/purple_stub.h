@@ -0,0 +1,81 @@
+/*
+ * F-List Pidgin - a libpurple protocol plugin for F-Chat
+ *
+ * Copyright 2011 F-List Pidgin developers.
+ *
+ * This file is part of F-List Pidgin.
+ *
+ * F-List Pidgin is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * F-List Pidgin is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with F-List Pidgin.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FLIST_PURPLE_STUB_H
+#define	FLIST_PURPLE_STUB_H
+
+/* A stand-in for the parts of libpurple the plugin calls, so the protocol */
+/* code can be driven outside of a client. The buddy list and conversations */
+/* are kept just well enough for the plugin to find what it created. */
+
+#include "f-list.h"
+#include "accountopt.h"
+#include "blist.h"
+#include "buddyicon.h"
+#include "connection.h"
+#include "conversation.h"
+#include "eventloop.h"
+#include "notify.h"
+#include "plugin.h"
+#include "prpl.h"
+#include "proxy.h"
+#include "roomlist.h"
+#include "server.h"
+#include "status.h"
+#include "value.h"
+
+typedef struct PurpleStubStats_ PurpleStubStats;
+
+/* what the plugin handed to the UI, so a run can be checked for sanity */
+struct PurpleStubStats_ {
+    guint64 chat_messages; /* serv_got_chat_in */
+    guint64 im_messages; /* serv_got_im */
+    guint64 conversation_writes; /* system messages written to a conversation */
+    guint64 user_status; /* purple_prpl_got_user_status */
+    guint64 chat_users_added;
+    guint64 chat_users_removed;
+    guint64 buddies_added;
+    guint64 buddies_removed;
+};
+
+extern PurpleStubStats purple_stub_stats;
+
+/* sees every message the plugin hands to serv_got_chat_in */
+typedef void (*PurpleStubChatHook)(PurpleConnection *pc, int id, const char *who, const char *message);
+
+void purple_stub_init(gboolean verbose);
+/* forgets the buddy list, conversations, handlers and settings */
+void purple_stub_reset(void);
+
+/* account settings, returned in place of the defaults the plugin asks with */
+void purple_stub_set_setting(const gchar *name, const gchar *value);
+/* these two are kept by purple_stub_reset */
+void purple_stub_set_chat_hook(PurpleStubChatHook hook);
+/* Lets purple_proxy_connect and purple_util_fetch_url_request reach this */
+/* host, such as a local mock server. Nothing else is ever contacted. */
+void purple_stub_allow_host(const gchar *host);
+
+/* runs the input handlers that are ready and the timeouts that are due, */
+/* waiting up to timeout milliseconds; returns the number of callbacks run */
+guint purple_stub_dispatch(gint timeout);
+/* the reason given to the last purple_connection_error_reason, if any */
+const gchar *purple_stub_error(void);
+
+#endif	/* FLIST_PURPLE_STUB_H */